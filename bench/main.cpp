@@ -0,0 +1,303 @@
+//  bench: measures each stage of busplan separately on a network directory.
+//
+//  Stages: INI parse, resolveImports, read() into Lines, BusNetwork construction,
+//  planFromArrive on random (from, to, arrive, day) queries and table(). Reports percentiles,
+//  throughput, peak RSS and the locality of the graph (mean edge span), as text or as JSON to
+//  compare runs across commits or vertex orders.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/value_semantic.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "../busplan/bus_network.hpp"
+#include "../busplan/config.hpp"
+#include "../busplan/day.hpp"
+#include "../busplan/details.hpp"
+#include "../busplan/lines.hpp"
+#include "../utility/ini_doc.hpp"
+
+namespace {
+
+using BenchClock = std::chrono::steady_clock;
+
+struct Stage {
+    explicit Stage(std::string n): name{std::move(n)}, micros{}, failures{0} {
+    }
+
+    template <typename Function>
+    void measure(Function function) {
+        auto    start = BenchClock::now();
+        try {
+            function();
+        } catch (const std::exception&) {
+            ++failures;
+        }
+        micros.push_back(std::chrono::duration<double, std::micro>(BenchClock::now() - start).count());
+    }
+
+    double percentile(double p) const {
+        if (micros.empty()) {
+            return 0.0;
+        }
+        auto    sorted = micros;
+        std::sort(sorted.begin(), sorted.end());
+        auto    ix = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+        return sorted[ix];
+    }
+    double total() const {
+        double  rv = 0.0;
+        for (auto m: micros) {
+            rv += m;
+        }
+        return rv;
+    }
+    double mean() const {
+        return micros.empty() ? 0.0 : total() / micros.size();
+    }
+    double throughput() const {
+        return total() > 0.0 ? micros.size() * 1e6 / total() : 0.0;
+    }
+
+    std::string         name;
+    std::vector<double> micros;
+    size_t              failures;
+};
+
+std::string readFile(const std::string& fname) {
+    std::ifstream   is(fname);
+    if (!is.is_open()) {
+        throw std::runtime_error(std::string{"Unable to open \""}.append(fname).append("\""));
+    }
+    std::ostringstream  oss;
+    oss << is.rdbuf();
+    return oss.str();
+}
+
+//  Contents of busplan.cfg and of every file it imports, transitively.
+std::vector<std::string> readConfigFiles(const std::string& dir) {
+    std::vector<std::string>    rv;
+    std::vector<std::string>    pending{"busplan.cfg"};
+    while (!pending.empty()) {
+        rv.push_back(readFile(dir + "/" + pending.back()));
+        pending.pop_back();
+
+        Utility::IniDoc     config;
+        std::istringstream  iss{rv.back()};
+        iss >> config;
+        if (config.doc().at("").count("imports")) {
+            for (const auto& importstr: config.doc().at("").at("imports").items()) {
+                pending.push_back(importstr);
+            }
+        }
+    }
+    return rv;
+}
+
+long peakRssKiB() {
+    rusage  usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void writeText(std::ostream& os, const std::string& network, const std::vector<Stage>& stages, double edgeSpan) {
+    os << "network: " << network << std::endl;
+    os << std::left << std::setw(18) << "stage" << std::right;
+    os << std::setw(8) << "count" << std::setw(12) << "mean(us)" << std::setw(12) << "p50(us)";
+    os << std::setw(12) << "p90(us)" << std::setw(12) << "p99(us)" << std::setw(12) << "max(us)";
+    os << std::setw(12) << "ops/s" << std::setw(8) << "fail" << std::endl;
+    os << std::fixed << std::setprecision(1);
+    for (const auto& stage: stages) {
+        os << std::left << std::setw(18) << stage.name << std::right;
+        os << std::setw(8) << stage.micros.size() << std::setw(12) << stage.mean();
+        os << std::setw(12) << stage.percentile(50) << std::setw(12) << stage.percentile(90);
+        os << std::setw(12) << stage.percentile(99) << std::setw(12) << stage.percentile(100);
+        os << std::setw(12) << stage.throughput() << std::setw(8) << stage.failures << std::endl;
+    }
+    os << "peak RSS: " << peakRssKiB() << " KiB" << std::endl;
+    os << "mean edge span: " << edgeSpan << " vertices" << std::endl;
+}
+
+//  'str' as a JSON string, quotes included.
+std::string jsonString(const std::string& str) {
+    std::string rv{"\""};
+    for (auto c: str) {
+        if (c == '"' || c == '\\') {
+            rv.append(1, '\\').append(1, c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            const char* const   digits = "0123456789abcdef";
+            rv.append("\\u00").append(1, digits[c >> 4]).append(1, digits[c & 0xf]);
+        } else {
+            rv.append(1, c);
+        }
+    }
+    return rv.append(1, '"');
+}
+
+void writeJson(std::ostream& os, const std::string& network, const std::vector<Stage>& stages, double edgeSpan) {
+    os << std::fixed << std::setprecision(3);
+    os << "{" << std::endl;
+    os << "  \"network\": " << jsonString(network) << "," << std::endl;
+    os << "  \"peak_rss_kib\": " << peakRssKiB() << "," << std::endl;
+    os << "  \"mean_edge_span\": " << edgeSpan << "," << std::endl;
+    os << "  \"stages\": [" << std::endl;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const auto& stage = stages[i];
+        os << "    {\"name\": " << jsonString(stage.name) << ", \"count\": " << stage.micros.size();
+        os << ", \"failures\": " << stage.failures;
+        os << ", \"mean_us\": " << stage.mean();
+        os << ", \"p50_us\": " << stage.percentile(50);
+        os << ", \"p90_us\": " << stage.percentile(90);
+        os << ", \"p99_us\": " << stage.percentile(99);
+        os << ", \"max_us\": " << stage.percentile(100);
+        os << ", \"ops_per_s\": " << stage.throughput() << "}";
+        os << (i + 1 < stages.size() ? "," : "") << std::endl;
+    }
+    os << "  ]" << std::endl;
+    os << "}" << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    namespace po = boost::program_options;
+
+    std::string     network;
+    size_t          repeat, plans, tables;
+    unsigned long   seed;
+    Details         details;
+
+    po::options_description desc("Options");
+    desc.add_options()
+        ("help", "show this help")
+        ("network", po::value<std::string>(&network)->value_name("DIR")->default_value("."))
+        ("repeat", po::value<size_t>(&repeat)->value_name("N")->default_value(3), "runs of each load stage, 1 at least")
+        ("plans", po::value<size_t>(&plans)->value_name("N")->default_value(100), "random get-plan queries")
+        ("tables", po::value<size_t>(&tables)->value_name("N")->default_value(5), "random get-table queries")
+        ("seed", po::value<unsigned long>(&seed)->value_name("N")->default_value(1))
+        ("details", po::value<Details>(&details)->value_name("DETAILS")->default_value(Details::steps))
+        ("lexical-order", "number the stops of the graph in lexical order, as before locality ordering")
+        ("json", "write the report as JSON")
+        ;
+    po::variables_map   vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+        //  every stage is run at least once: the network of the last run is the one queried.
+        if (repeat < 1) {
+            throw po::validation_error{po::validation_error::invalid_option_value, "--repeat"};
+        }
+    } catch (const po::error& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "(Try \"bench --help\")" << std::endl;
+        return 1;
+    }
+    if (vm.count("help")) {
+        std::cout << "Usage:" << std::endl;
+        std::cout << "  bench [options]" << std::endl << std::endl;
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    std::vector<Stage>  stages{
+        Stage{"ini-parse"}, Stage{"resolve-imports"}, Stage{"read"}, Stage{"network-build"},
+        Stage{"plan"}, Stage{"table"}};
+    auto&   parseStage = stages[0];
+    auto&   importsStage = stages[1];
+    auto&   readStage = stages[2];
+    auto&   buildStage = stages[3];
+    auto&   planStage = stages[4];
+    auto&   tableStage = stages[5];
+
+    auto    order = vm.count("lexical-order") ? BusNetwork::VertexOrder::lexical : BusNetwork::VertexOrder::locality;
+    double  edgeSpan = 0.0;
+    try {
+        auto    files = readConfigFiles(network);
+        for (size_t r = 0; r < repeat; ++r) {
+            parseStage.measure([&files]() {
+                for (const auto& file: files) {
+                    Utility::IniDoc     config;
+                    std::istringstream  iss{file};
+                    iss >> config;
+                }
+            });
+        }
+
+        Utility::IniDoc     config;
+        for (size_t r = 0; r < repeat; ++r) {
+            config.clear();
+            getConfig(config, network + "/busplan.cfg");
+            importsStage.measure([&config, &network]() {
+                resolveImports(config, network);
+            });
+        }
+
+        Lines               lines;
+        StopDescriptions    stopdescs;
+        for (size_t r = 0; r < repeat; ++r) {
+            lines = Lines{};
+            stopdescs.clear();
+            readStage.measure([&config, &lines, &stopdescs]() {
+                read(config.doc(), lines, stopdescs);
+            });
+        }
+
+        auto    stopSet = lines.getStopSet();
+        Stops   stops(stopSet.cbegin(), stopSet.cend());
+        std::unique_ptr<BusNetwork> busNetwork;
+        for (size_t r = 0; r < repeat; ++r) {
+            Lines   input{r + 1 < repeat ? lines : std::move(lines)};
+            busNetwork.reset();
+            buildStage.measure([&busNetwork, &input, order]() {
+                busNetwork.reset(new BusNetwork{std::move(input), order});
+            });
+        }
+        edgeSpan = busNetwork->meanEdgeSpan();
+
+        std::mt19937_64                         random{seed};
+        std::uniform_int_distribution<size_t>   stopDist{0, stops.size() - 1};
+        std::uniform_int_distribution<int>      minuteDist{6 * 60, 23 * 60};
+        std::uniform_int_distribution<size_t>   dayDist{0, 6};
+        for (size_t q = 0; q < plans; ++q) {
+            const auto& from = stops[stopDist(random)];
+            const auto& to = stops[stopDist(random)];
+            Time        arrive{DifTime{minuteDist(random)}};
+            Day         day{dayDist(random)};
+            planStage.measure([&busNetwork, day, &from, &to, arrive, details]() {
+                busNetwork->planFromArrive(day, from, to, arrive, details);
+            });
+        }
+        for (size_t q = 0; q < tables; ++q) {
+            const auto& from = stops[stopDist(random)];
+            const auto& to = stops[stopDist(random)];
+            Day         day{dayDist(random)};
+            tableStage.measure([&busNetwork, day, &from, &to, details]() {
+                busNetwork->table(day, from, to, details);
+            });
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    if (vm.count("json")) {
+        writeJson(std::cout, network, stages, edgeSpan);
+    } else {
+        writeText(std::cout, network, stages, edgeSpan);
+    }
+    return 0;
+}
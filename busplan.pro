@@ -2,43 +2,31 @@ TEMPLATE = app
 CONFIG += console
 CONFIG -= app_bundle
 CONFIG -= qt
+CONFIG += thread
 
-SOURCES += \
-    busplan/bus_network.cpp \
-    busplan/config.cpp \
-    busplan/main.cpp \
-    busplan/options.cpp \
-    utility/ini_doc.cpp \
-    busplan/day.cpp \
-    busplan/details.cpp \
-    busplan/line.cpp \
-    busplan/lines.cpp \
-    busplan/fragment.cpp \
-    busplan/schedule.cpp \
-    busplan/time_line.cpp
-
-HEADERS += \
-    busplan/lines.hpp \
-    busplan/bus_network.hpp \
-    busplan/walking.hpp \
-    busplan/time.hpp \
-    busplan/stop.hpp \
-    busplan/config.hpp \
-    busplan/route.hpp \
-    busplan/line.hpp \
-    busplan/schedule.hpp \
-    busplan/algorithm.hpp \
-    busplan/options.hpp \
-    busplan/time_line.hpp \
-    utility/literal.hpp \
-    utility/ini_doc.hpp \
-    busplan/day.hpp \
-    busplan/details.hpp \
-    busplan/fragment.hpp
+include(busplan/busplan.pri)
 
+SOURCES += \
+    busplan/allocations.cpp \
+    busplan/main.cpp
 
 unix|win32: LIBS += -lboost_program_options
 
+#   qmake NETWORK=networks/lux: the network is compiled into the binary by netcode (built
+#   beforehand from netcode.pro, in the same build directory) instead of read from busplan.cfg
+#   at startup.
+!isEmpty(NETWORK) {
+    DEFINES += STATIC_NETWORK
+    INCLUDEPATH += $$PWD
+    static_network_data.target = static_network_data.cpp
+    static_network_data.commands = $$OUT_PWD/netcode --network $$PWD/$$NETWORK --output static_network_data.cpp
+    static_network_data.depends = $$files($$PWD/$$NETWORK/*.cfg)
+    QMAKE_EXTRA_TARGETS += static_network_data
+    PRE_TARGETDEPS += static_network_data.cpp
+    GENERATED_SOURCES += static_network_data.cpp
+    QMAKE_CLEAN += static_network_data.cpp
+}
+
 OTHER_FILES += \
     networks/lux/7xx.lines.cfg \
     networks/lux/walking.cfg \
@@ -2,8 +2,10 @@
 #ifndef ALGORITHM_HPP
 #define ALGORITHM_HPP
 
+#include <cstddef>
 #include <iterator>
 #include <utility>
+#include <vector>
 
 template <
     typename InputIt,
@@ -29,4 +31,29 @@ getKeyVector(const Cont& cont) {
     return rv;
 }
 
+//  A pair of iterators usable in range-based for loops.
+template <typename It>
+struct Range {
+    It begin() const {
+        return first;
+    }
+    It end() const {
+        return last;
+    }
+    size_t size() const {
+        return static_cast<size_t>(std::distance(first, last));
+    }
+    bool empty() const {
+        return first == last;
+    }
+
+    It  first;
+    It  last;
+};
+
+template <typename It>
+Range<It> makeRange(It first, It last) {
+    return Range<It>{first, last};
+}
+
 #endif // ALGORITHM_HPP
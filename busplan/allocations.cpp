@@ -0,0 +1,41 @@
+#include <cstdlib>
+#include <new>
+
+#include "stats.hpp"
+
+//  The global operator new and delete, counting the allocations for --stats. Built into busplan
+//  alone, so that the tools sharing busplan.pri keep the ones of the standard library.
+
+void* operator new(std::size_t size) {
+    countAllocation();
+    for (;;) {
+        if (auto p = std::malloc(size ? size : 1)) {
+            return p;
+        }
+        auto    handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc{};
+        }
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
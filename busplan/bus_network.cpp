@@ -1,187 +1,1133 @@
 #include <algorithm>
 #include <functional>
-#include <boost/graph/dijkstra_shortest_paths.hpp>
+#include <numeric>
+#include <unordered_map>
+
+#include <boost/graph/compressed_sparse_row_graph.hpp>
+#include <boost/graph/cuthill_mckee_ordering.hpp>
 
 #include "bus_network.hpp"
 #include "time.hpp"
 
 #include <iostream>
 
-inline DifTime adjust(const RouteId& rida, const RouteId& ridb) {
-    if (rida == ridb || rida == walkingRouteId) {
+DifTime BusNetwork::adjust(std::uint32_t routea, std::uint32_t routeb) {
+    if (routea == routeb || routea == walkingRoute) {
         return DifTime{0};
     }
-    return std::chrono::minutes{5};
+    return transferTime;
 }
 
-BusNetwork::BusNetwork(Lines&& lines): lines_{std::move(lines)}, graph_{}, stopMap_{} {
-    auto    stops = lines_.getStopSet();
-    for(const auto& stop: stops) {
-        stopMap_[stop] = boost::add_vertex(stop, graph_);
-//        std::clog << "vertex " << stopMap_[stop] << ": " << stop << std::endl;
+BusNetwork::BusNetwork(Lines&& lines, VertexOrder order):
+    lines_{std::move(lines)}, directConnections_{lines_}, delays_{}, graph_{}, stopMap_{},
+    engine_{Engine::dijkstra}, preferDirect_{false}, tripBased_{}, transferPatterns_{}, connectionScan_{}, edges_{},
+    transitEdges_{}, footpathEdges_{}, inEdgeOffsets_{}, inEdges_{}, stopIndex_{}, indexedStops_{}, accessCount_{4}, accessRadius_{500.0},
+    walkingSpeed_{defaultWalkingSpeed}, planCache_{}, cacheBucket_{1}, dayFlags_{}, edgeOffsets_{}, edgeTimes_{},
+    firstServices_{}, serviceOffsets_{}, serviceTimes_{}, serviceIds_{} {
+
+    //  the ends of every step and walk are looked up once, by the lexical index of the stop.
+    auto    stopSet = lines_.getStopSet();
+    Stops   stops(stopSet.cbegin(), stopSet.cend());
+    std::unordered_map<Stop, size_t>    stopIxs;
+    stopIxs.reserve(stops.size());
+    for (size_t ix = 0; ix < stops.size(); ++ix) {
+        stopIxs.emplace(stops[ix], ix);
     }
-    auto    stepsLines = lines_.getBackwardStepsLines();
-    for (const auto& stepsByLine: stepsLines) {
+    struct PendingEdge {
+        size_t  fromIx;
+        size_t  toIx;
+        Section section;
+    };
+    std::vector<PendingEdge>    pending;
+    std::uint32_t               routeCount = walkingRoute + 1;
+    for (const auto& stepsByLine: lines_.getBackwardStepsLines()) {
         const auto& linen = stepsByLine.first;
         for (const auto& stepsByRoute: stepsByLine.second) {
             const auto& routen = stepsByRoute.first;
             for (const auto& step: stepsByRoute.second) {
                 const auto& from = step.first;
                 const auto& to = step.second;
-                /*auto    e =*/ boost::add_edge(
-                    stopMap_.at(from),
-                    stopMap_.at(to),
-                    Section{RouteId{linen, routen}, from, to}, graph_);
-//                std::clog << "edge " << e.first << ": " << from << " -> " << to << std::endl;
+                pending.push_back(PendingEdge{
+                    stopIxs.at(from), stopIxs.at(to),
+                    Section{RouteId{linen, routen}, from, to, routeCount, 0, DifTime{}}});
             }
+            ++routeCount;
         }
     }
     for (const auto& walkingTime: lines_.walkingTimes()) {
         const auto& from = walkingTime.first.first;
         const auto& to = walkingTime.first.second;
-        boost::add_edge(
-            stopMap_.at(from), stopMap_.at(to), Section{walkingRouteId, from, to}, graph_);
-        boost::add_edge(
-            stopMap_.at(to), stopMap_.at(from), Section{walkingRouteId, to, from}, graph_);
+        const auto& walk = walkingTime.second;
+        auto        fromIx = stopIxs.at(from);
+        auto        toIx = stopIxs.at(to);
+        pending.push_back(PendingEdge{fromIx, toIx, Section{walkingRouteId, from, to, walkingRoute, 0, walk}});
+        pending.push_back(PendingEdge{toIx, fromIx, Section{walkingRouteId, to, from, walkingRoute, 0, walk}});
+    }
+
+    std::vector<size_t> numbering(stops.size());
+    if (order == VertexOrder::locality) {
+        Links   links;
+        links.reserve(pending.size());
+        for (const auto& edge: pending) {
+            links.emplace_back(edge.fromIx, edge.toIx);
+        }
+        numbering = localityOrder(stops.size(), links);
+    } else {
+        std::iota(numbering.begin(), numbering.end(), 0);
+    }
+    std::vector<VertexDesc> vertices(stops.size());
+    for (auto ix: numbering) {
+        vertices[ix] = boost::add_vertex(stops[ix], graph_);
+    }
+    for (size_t ix = 0; ix < stops.size(); ++ix) {
+        stopMap_.emplace_hint(stopMap_.end(), stops[ix], vertices[ix]);
+    }
+    //  the stops with coordinates, for the queries from or to a position.
+    std::vector<Coordinates>    points;
+    for (const auto& stopCoordinates: lines_.stopCoordinates()) {
+        auto    it = stopIxs.find(stopCoordinates.first);
+        if (it != stopIxs.cend()) {
+            points.push_back(stopCoordinates.second);
+            indexedStops_.push_back(vertices[it->second]);
+        }
+    }
+    stopIndex_ = SpatialIndex{points, accessRadius_};
+
+    //  The search breaks ties between equal labels by the order of the out edges: they are kept
+    //  by lexical order of their targets whatever the numbering, so that plans do not depend on
+    //  it.
+    std::vector<size_t> edgeOrder(pending.size());
+    std::iota(edgeOrder.begin(), edgeOrder.end(), 0);
+    std::stable_sort(edgeOrder.begin(), edgeOrder.end(), [&pending](size_t a, size_t b) {
+        const auto& ea = pending[a];
+        const auto& eb = pending[b];
+        return ea.fromIx < eb.fromIx || (ea.fromIx == eb.fromIx && ea.toIx < eb.toIx);
+    });
+    for (auto ix: edgeOrder) {
+        auto&   edge = pending[ix];
+        boost::add_edge(vertices[edge.fromIx], vertices[edge.toIx], std::move(edge.section), graph_);
+    }
+
+    //  edges (and so their stop times) are numbered by source vertex, the order the search
+    //  reads them in.
+    edges_.reserve(boost::num_edges(graph_));
+    auto    vertexr = boost::vertices(graph_);
+    for (auto vit = vertexr.first; vit != vertexr.second; ++vit) {
+        transitEdges_.offsets.push_back(transitEdges_.edges.size());
+        footpathEdges_.offsets.push_back(footpathEdges_.edges.size());
+        auto    er = boost::out_edges(*vit, graph_);
+        for (auto eit = er.first; eit != er.second; ++eit) {
+            auto&   section = graph_[*eit];
+            auto    target = boost::target(*eit, graph_);
+            section.index = edges_.size();
+            edges_.push_back(*eit);
+            if (section.route == walkingRoute) {
+                footpathEdges_.edges.push_back(
+                    FootpathEdge{target, section.walk, static_cast<std::uint32_t>(section.index)});
+            } else {
+                transitEdges_.edges.push_back(
+                    TransitEdge{target, section.route, static_cast<std::uint32_t>(section.index)});
+            }
+        }
+    }
+    transitEdges_.offsets.push_back(transitEdges_.edges.size());
+    footpathEdges_.offsets.push_back(footpathEdges_.edges.size());
+
+    inEdgeOffsets_.assign(boost::num_vertices(graph_) + 1, 0);
+    for (const auto& ed: edges_) {
+        ++inEdgeOffsets_[boost::target(ed, graph_) + 1];
+    }
+    std::partial_sum(inEdgeOffsets_.begin(), inEdgeOffsets_.end(), inEdgeOffsets_.begin());
+    inEdges_.resize(edges_.size());
+    auto    next = inEdgeOffsets_;
+    for (size_t index = 0; index < edges_.size(); ++index) {
+        inEdges_[next[boost::target(edges_[index], graph_)]++] = static_cast<std::uint32_t>(index);
+    }
+
+    if (lines_.calendar().empty()) {
+        return;
+    }
+    serviceOffsets_.reserve(edges_.size() + 1);
+    for (const auto& ed: edges_) {
+        const auto& section = graph_[ed];
+        serviceOffsets_.push_back(serviceTimes_.size());
+        if (section.route != walkingRoute) {
+            for (const auto& timep: lines_.getServiceStopTimes(section.routeid, section.to)) {
+                serviceTimes_.push_back(timep.first);
+                serviceIds_.push_back(timep.second);
+            }
+        }
+    }
+    serviceOffsets_.push_back(serviceTimes_.size());
+}
+
+std::vector<size_t> BusNetwork::localityOrder(size_t stopCount, const Links& links) {
+    //  both directions of every link, in a compact graph: this runs on every build.
+    using StopGraph = boost::compressed_sparse_row_graph<boost::directedS>;
+    using StopVertex = boost::graph_traits<StopGraph>::vertex_descriptor;
+
+    std::vector<std::pair<StopVertex, StopVertex>>  edges;
+    edges.reserve(links.size() * 2);
+    for (const auto& link: links) {
+        edges.emplace_back(link.first, link.second);
+        edges.emplace_back(link.second, link.first);
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    StopGraph   graph{boost::edges_are_sorted, edges.cbegin(), edges.cend(), stopCount};
+
+    //  reverse Cuthill-McKee: breadth first from peripheral stops, so the stops of a route and
+    //  their neighbours get close numbers.
+    std::vector<StopVertex> permutation(stopCount);
+    boost::cuthill_mckee_ordering(graph, permutation.rbegin());
+    return std::vector<size_t>(permutation.cbegin(), permutation.cend());
+}
+
+double BusNetwork::meanEdgeSpan() const {
+    auto    edgeCount = boost::num_edges(graph_);
+    if (edgeCount == 0) {
+        return 0.0;
+    }
+    double  rv = 0.0;
+    for (const auto& ed: edges_) {
+        auto    s = boost::source(ed, graph_);
+        auto    t = boost::target(ed, graph_);
+        rv += s < t ? t - s : s - t;
+    }
+    return rv / edgeCount;
+}
+
+void BusNetwork::prepareDay(Day day) const {
+    std::call_once(dayFlags_[day], [this, day]() {
+        auto&   offsets = edgeOffsets_[day];
+        auto&   times = edgeTimes_[day];
+        auto&   firstServices = firstServices_[day];
+        offsets.reserve(edges_.size() + 1);
+        firstServices.assign(boost::num_vertices(graph_), Time::max());
+        for (const auto& ed: edges_) {
+            const auto& section = graph_[ed];
+            offsets.push_back(times.size());
+            if (section.route != walkingRoute) {
+                auto    timeline = lines_.getStopTimes(day, section.routeid, section.to);
+                times.insert(times.end(), timeline.cbegin(), timeline.cend());
+                if (!timeline.empty()) {
+                    auto&   first = firstServices[boost::source(ed, graph_)];
+                    first = std::min(first, timeline.front());
+                }
+            }
+        }
+        offsets.push_back(times.size());
+    });
+}
+
+BusNetwork::QueryContext::QueryContext():
+    network_{nullptr}, epoch_{0}, stamps_{}, labels_{}, predecessors_{}, finished_{}, queueIndex_{},
+    queue_{LabelMap{this}, QueueIndexMap{this}}, snapshot_{}, delays_{nullptr}, calendarDate_{noDate}, delayedStamps_{},
+    delayedTimes_{},
+    nodes_{}, origins_{}, targets_{}, originStamps_{}, pathStamps_{}, path_{}, origin_{0}, target_{0} {
+}
+
+bool BusNetwork::QueryContext::LaterLabel::operator()(const Label& labela, const Label& labelb) const {
+    return labela.time > labelb.time + adjust(labela.route, labelb.route);
+}
+
+void BusNetwork::QueryContext::begin(const BusNetwork& network) {
+    auto    vertexCount = boost::num_vertices(network.graph_);
+    auto    edgeCount = network.edges_.size();
+    if (network_ != &network || stamps_.size() != vertexCount || delayedStamps_.size() != edgeCount) {
+        network_ = &network;
+        epoch_ = 0;
+        stamps_.assign(vertexCount, 0);
+        labels_.resize(vertexCount);
+        predecessors_.resize(vertexCount);
+        finished_.resize(vertexCount);
+        queueIndex_.assign(vertexCount, static_cast<size_t>(-1));
+        delayedStamps_.assign(edgeCount, 0);
+        delayedTimes_.resize(edgeCount);
+        originStamps_.assign(vertexCount, 0);
+        pathStamps_.assign(vertexCount, 0);
+    }
+    if (++epoch_ == 0) {
+        std::fill(stamps_.begin(), stamps_.end(), 0);
+        std::fill(delayedStamps_.begin(), delayedStamps_.end(), 0);
+        std::fill(originStamps_.begin(), originStamps_.end(), 0);
+        std::fill(pathStamps_.begin(), pathStamps_.end(), 0);
+        epoch_ = 1;
+    }
+}
+
+Time BusNetwork::latestService(size_t index, Time time, Date date) const {
+    //  a bit test per trip, from the latest one by 'time' backwards.
+    const auto& calendar = lines_.calendar();
+    auto        first = serviceTimes_.cbegin() + serviceOffsets_[index];
+    auto        it = std::upper_bound(first, serviceTimes_.cbegin() + serviceOffsets_[index + 1], time);
+    while (it != first) {
+        --it;
+        if (calendar.runs(serviceIds_[it - serviceTimes_.cbegin()], date)) {
+            return *it;
+        }
+    }
+    return minusInf;
+}
+
+std::pair<const Time*, const Time*> BusNetwork::QueryContext::edgeTimes(
+    const BusNetwork& network, Day day, size_t index) {
+
+    const auto& offsets = network.edgeOffsets_[day];
+    const auto  times = network.edgeTimes_[day].data();
+    if (!delays_) {
+        return std::make_pair(times + offsets[index], times + offsets[index + 1]);
+    }
+    auto&   delayed = delayedTimes_[index];
+    if (delayedStamps_[index] != epoch_) {
+        const auto& section = network.graph_[network.edges_[index]];
+        delayed.assign(times + offsets[index], times + offsets[index + 1]);
+        //  with the trips of the services running, to be delayed too.
+        if (calendarDate_ != noDate) {
+            const auto& calendar = network.lines_.calendar();
+            auto        middle = delayed.size();
+            for (auto ix = network.serviceOffsets_[index]; ix < network.serviceOffsets_[index + 1]; ++ix) {
+                if (calendar.runs(network.serviceIds_[ix], calendarDate_)) {
+                    delayed.push_back(network.serviceTimes_[ix]);
+                }
+            }
+            std::inplace_merge(delayed.begin(), delayed.begin() + middle, delayed.end());
+        }
+        delays_->applyTo(section.routeid, section.to, delayed);
+        delayedStamps_[index] = epoch_;
+    }
+    return std::make_pair(delayed.data(), delayed.data() + delayed.size());
+}
+
+void BusNetwork::setEngine(Engine engine, unsigned threads) {
+    if (engine == Engine::tripBased) {
+        for (auto day: week) {
+            if (!tripBased_[day]) {
+                tripBased_[day].reset(new TripBased{lines_, day, threads});
+            }
+        }
+    }
+    if (engine == Engine::transferPatterns && !transferPatterns_) {
+        transferPatterns_.reset(new TransferPatterns{lines_, threads});
+    }
+    if (engine == Engine::connectionScan) {
+        for (auto day: week) {
+            if (!connectionScan_[day]) {
+                connectionScan_[day].reset(new ConnectionScan{lines_, day});
+            }
+        }
+    }
+    engine_ = engine;
+    clearCache();
+}
+
+void BusNetwork::readIndex(Engine engine, std::istream& is) {
+    if (engine == Engine::tripBased) {
+        std::array<std::unique_ptr<TripBased>, 7>   tripBased;
+        for (auto day: week) {
+            tripBased[day].reset(new TripBased{lines_, day, is});
+        }
+        tripBased_ = std::move(tripBased);
+    } else if (engine == Engine::transferPatterns) {
+        transferPatterns_.reset(new TransferPatterns{lines_, is});
+    }
+    engine_ = engine;
+    clearCache();
+}
+
+void BusNetwork::writeIndex(std::ostream& os) const {
+    if (engine_ == Engine::tripBased) {
+        for (auto day: week) {
+            tripBased_[day]->write(os);
+        }
+    } else if (engine_ == Engine::transferPatterns) {
+        transferPatterns_->write(os);
+    }
+}
+
+size_t BusNetwork::indexMemoryUsage() const {
+    size_t  rv = 0;
+    if (engine_ == Engine::tripBased) {
+        for (auto day: week) {
+            rv += tripBased_[day]->memoryUsage();
+        }
+    } else if (engine_ == Engine::transferPatterns) {
+        rv += transferPatterns_->memoryUsage();
+    } else if (engine_ == Engine::connectionScan) {
+        for (auto day: week) {
+            rv += connectionScan_[day]->memoryUsage();
+        }
     }
+    return rv;
 }
 
 BusNetwork::NodeList BusNetwork::planFromArrive(
-    Day day, const Stop& from, const Stop& to, Time arrive, Details details) {
+    Day day, const Stop& from, const Stop& to, Time arrive, Details details, QueryStats* stats) const {
+
+    static thread_local QueryContext    context;
+    auto                                count = cachedPlan(context, day, from, to, arrive, details, stats);
+    ScopedAllocationCounter             allocationCounter{stats};
+    return NodeList(context.nodes_.cbegin(), context.nodes_.cbegin() + count);
+}
+
+void BusNetwork::setCache(size_t capacity, std::chrono::seconds ttl, DifTime bucket) {
+    planCache_.reset(capacity ? new PlanCache{capacity, ttl} : nullptr);
+    cacheBucket_ = std::max(bucket, DifTime{1});
+}
+
+size_t BusNetwork::PlanKeyHash::operator()(const PlanKey& key) const {
+    std::hash<std::string>  hash;
+    auto    rv = hash(key.from);
+    rv = rv * 31 + hash(key.to);
+    rv = rv * 31 + key.day;
+    rv = rv * 31 + static_cast<size_t>(key.date);
+    rv = rv * 31 + static_cast<size_t>(key.arrive.time_since_epoch().count());
+    return rv * 31 + static_cast<size_t>(key.details);
+}
+
+BusNetwork::PlanKey BusNetwork::planKey(
+    Day day, const Stop& from, const Stop& to, Time arrive, Details details) const {
 
-    BusNetwork::NodeList    rv;
+    auto    since = arrive.time_since_epoch();
+    return PlanKey{
+        from, to, day, day.date(), Time{since - (since % cacheBucket_ + cacheBucket_) % cacheBucket_}, details};
+}
 
-    using DistanceMap = std::map<VertexDesc, StopTime>;
-    using PredecessorMap = std::map<VertexDesc, VertexDesc>;
-    using WeightMap = std::map<EdgeDesc, SectionTime>;
+size_t BusNetwork::cachedPlan(
+    QueryContext& context, Day day, const Stop& from, const Stop& to, Time arrive, Details details,
+    QueryStats* stats) const {
 
-    PredecessorMap  p;
-    DistanceMap     d;
-    WeightMap       w;
+    if (!planCache_) {
+        return plan(context, day, from, to, arrive, details, stats);
+    }
+    //  a published snapshot has a new version, whatever day it applies to.
+    auto        generation = delays_.snapshot()->version();
+    auto        key = planKey(day, from, to, arrive, details);
+    NodeList    nodes;
+    if (planCache_->find(key, generation, nodes)) {
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            context.node(i) = nodes[i];
+        }
+        return nodes.size();
+    }
+    auto    count = plan(context, day, from, to, key.arrive, details, stats);
+    planCache_->insert(key, generation, NodeList(context.nodes_.cbegin(), context.nodes_.cbegin() + count));
+    return count;
+}
 
-    auto    compare = [](const StopTime& stopta, const StopTime& stoptb) {
-//        std::clog << "\t" << stopta.routeid.linen << "." << stopta.routeid.routen << "\t";
-//        std::clog << toString(stopta.time) << "\t";
-//        std::clog << "\t" << stoptb.routeid.linen << "." << stoptb.routeid.routen << "\t";
-//        std::clog << toString(stoptb.time) << "\t";
-//        std::clog << (stopta.time > stoptb.time + adjust(stopta.routeid, stoptb.routeid));
-//        std::clog << std::endl;
+BusNetwork::Table BusNetwork::planFromArrive(
+    Day day, const Stops& froms, const Stop& to, Time arrive, Details details, QueryStats* stats) const {
+
+    Table   rv;
+    rv.reserve(froms.size());
+    //  the plans of the other engines, and the direct ones, do not come from the graph search,
+    //  which answers all those it alone knows about.
+    if ((engine_ != Engine::dijkstra || preferDirect_) && !needsGraph(day)) {
+        for (const auto& from: froms) {
+            rv.push_back(planFromArrive(day, from, to, arrive, details, stats));
+        }
+        return rv;
+    }
 
-        return stopta.time > stoptb.time + adjust(stopta.routeid, stoptb.routeid);
+    static thread_local QueryContext    context;
+    ScopedAllocationCounter             allocationCounter{stats};
+    //  the search is only from the origins the cache has no plan from.
+    auto                generation = delays_.snapshot()->version();
+    std::vector<size_t> searched;
+    rv.resize(froms.size());
+    context.targets_.assign(1, Access{stopMap_.at(to), DifTime{0}, noRoute});
+    context.origins_.clear();
+    for (size_t ix = 0; ix < froms.size(); ++ix) {
+        if (planCache_ && planCache_->find(planKey(day, froms[ix], to, arrive, details), generation, rv[ix])) {
+            continue;
+        }
+        searched.push_back(ix);
+        context.origins_.push_back(Access{stopMap_.at(froms[ix]), DifTime{0}, noRoute});
+    }
+    if (searched.empty()) {
+        return rv;
+    }
+    //  the labels and predecessors of a settled vertex are final: every origin reads its plan
+    //  from the same search, as if the search had stopped there.
+    auto    key = planKey(day, to, to, arrive, details);
+    search(context, day, key.arrive, true, stats);
+    for (size_t k = 0; k < searched.size(); ++k) {
+        VertexDesc  root;
+        auto        count = reconstruct(context, day, context.origins_[k].vertex, root, stats);
+        count = applyDetails(context.nodes_, count, details, stats);
+        auto&       nodes = rv[searched[k]];
+        nodes.assign(context.nodes_.cbegin(), context.nodes_.cbegin() + count);
+        if (planCache_) {
+            key.from = froms[searched[k]];
+            planCache_->insert(key, generation, nodes);
+        }
+    }
+    return rv;
+}
+
+BusNetwork::NodeList BusNetwork::planFromArrive(
+    Day day, const Place& from, const Place& to, Time arrive, Details details, QueryStats* stats) const {
+
+    static thread_local QueryContext    context;
+    ScopedAllocationCounter             allocationCounter{stats};
+    access(to, context.targets_);
+    access(from, context.origins_);
+    auto    count = planDijkstra(context, day, arrive, stats);
+    if (context.origin_ == context.origins_.size()) {
+        return NodeList{};
+    }
+
+    //  the walks from and to the positions, around the plan between their stops.
+    auto    walk = [&count](const Stop& from, Time leave, const Stop& to, DifTime duration) {
+        auto&   node = context.node(count++);
+        node.from = RoutePoint{from, leave, Lines::walkingPlatform()};
+        node.to = RoutePoint{to, leave + duration, Lines::walkingPlatform()};
+        node.routeid = walkingRouteId;
     };
-    auto    combine = [](const StopTime& stopt, const SectionTime& sectiont) {
-        Time    toTime = stopt.time - adjust(stopt.routeid, sectiont.routeid);
+    const auto& origin = context.origins_[context.origin_];
+    const auto& target = context.targets_[context.target_];
+    if (target.route == walkingRoute) {
+        auto    leave = count ? context.nodes_[count - 1].to.time : arrive - target.walk;
+        walk(graph_[target.vertex], leave, toString(to.position), target.walk);
+    }
+    if (origin.route == walkingRoute) {
+        auto    label = context.label(origin.vertex);
+        auto    leave = label.time - adjust(label.route, walkingRoute) - origin.walk;
+        walk(toString(from.position), leave, graph_[origin.vertex], origin.walk);
+        std::rotate(context.nodes_.begin(), context.nodes_.begin() + count - 1, context.nodes_.begin() + count);
+    }
+    count = applyDetails(context.nodes_, count, details, stats);
+    return NodeList(context.nodes_.cbegin(), context.nodes_.cbegin() + count);
+}
+
+BusNetwork::NodeList BusNetwork::planFromArrive(
+    Day day, const Stop& from, const Deadlines& tos, Details details, QueryStats* stats) const {
+
+    static thread_local QueryContext    context;
+    ScopedAllocationCounter             allocationCounter{stats};
+    if (tos.empty()) {
+        return NodeList{};
+    }
+    //  one search by the latest deadline, the stops to reach before it as if walked from.
+    auto    latest = tos.front().second;
+    for (const auto& to: tos) {
+        latest = std::max(latest, to.second);
+    }
+    context.targets_.clear();
+    for (const auto& to: tos) {
+        context.targets_.push_back(Access{stopMap_.at(to.first), latest - to.second, noRoute});
+    }
+    context.origins_.assign(1, Access{stopMap_.at(from), DifTime{0}, noRoute});
+    auto    count = planDijkstra(context, day, latest, stats);
+    if (context.origin_ == context.origins_.size()) {
+        return NodeList{};
+    }
+    count = applyDetails(context.nodes_, count, details, stats);
+    return NodeList(context.nodes_.cbegin(), context.nodes_.cbegin() + count);
+}
+
+void BusNetwork::access(const Place& place, Accesses& accesses) const {
+    accesses.clear();
+    if (!place.stops.empty()) {
+        for (const auto& stop: place.stops) {
+            accesses.push_back(Access{stopMap_.at(stop), DifTime{0}, noRoute});
+        }
+        return;
+    }
+    static thread_local SpatialIndex::Hits  hits;
+    stopIndex_.nearest(place.position, accessCount_, accessRadius_, hits);
+    if (hits.empty()) {
+        throw std::out_of_range(std::string{"No stop near "}.append(toString(place.position)));
+    }
+    for (const auto& hit: hits) {
+        accesses.push_back(Access{indexedStops_[hit.point], walkingTime(hit.distance, walkingSpeed_), walkingRoute});
+    }
+}
+
+size_t BusNetwork::plan(
+    QueryContext& context, Day day, const Stop& from, const Stop& to, Time arrive, Details details,
+    QueryStats* stats) const {
+
+    ScopedAllocationCounter allocationCounter{stats};
+    size_t                  count = 0;
+
+    auto        graph = needsGraph(day);
+    JourneyLeg  leg;
+    if (preferDirect_ && !graph && directConnections_.latestConnection(day, from, to, arrive, leg)) {
+        count = fromJourney(Journey{leg}, context);
+    } else if (engine_ != Engine::dijkstra && !graph) {
+        Journey journey;
+        if (engine_ == Engine::tripBased) {
+            tripBased_[day]->planFromArrive(from, to, arrive, journey, stats);
+        } else if (engine_ == Engine::connectionScan) {
+            std::vector<Journey>    journeys;
+            connectionScan_[day]->planFromArrive(from, to, std::vector<Time>{arrive}, journeys, stats);
+            journey = std::move(journeys.front());
+        } else {
+            transferPatterns_->planFromArrive(day, from, to, arrive, journey, stats);
+        }
+        count = fromJourney(journey, context);
+    } else {
+        context.targets_.assign(1, Access{stopMap_.at(to), DifTime{0}, noRoute});
+        context.origins_.assign(1, Access{stopMap_.at(from), DifTime{0}, noRoute});
+        count = planDijkstra(context, day, arrive, stats);
+    }
+    return applyDetails(context.nodes_, count, details, stats);
+}
+
+BusNetwork::Table BusNetwork::planFromArrive(
+    Day day, const Stop& from, const Stop& to, const std::vector<Time>& arrives, Details details,
+    QueryStats* stats) const {
+
+    Table   rv;
+    if (engine_ != Engine::connectionScan || needsGraph(day)) {
+        for (auto arrive: arrives) {
+            rv.push_back(planFromArrive(day, from, to, arrive, details, stats));
+        }
+        return rv;
+    }
+
+    static thread_local QueryContext    context;
+    std::vector<Journey>                journeys;
+    connectionScan_[day]->planFromArrive(from, to, arrives, journeys, stats);
+    for (size_t i = 0; i < arrives.size(); ++i) {
+        JourneyLeg  leg;
+        size_t      count = 0;
+        if (preferDirect_ && directConnections_.latestConnection(day, from, to, arrives[i], leg)) {
+            count = fromJourney(Journey{leg}, context);
+        } else {
+            count = fromJourney(journeys[i], context);
+        }
+        count = applyDetails(context.nodes_, count, details, stats);
+        rv.emplace_back(context.nodes_.cbegin(), context.nodes_.cbegin() + count);
+    }
+    return rv;
+}
+
+size_t BusNetwork::applyDetails(NodeList& nodes, size_t count, Details details, QueryStats* stats) {
+    ScopedTimer detailsTimer{stats, Phase::details};
+    if (details == Details::transfers) {
+        return fromStepToTransferList(nodes, count);
+    }
+    if (details == Details::ends) {
+        return fromStepToEndList(nodes, count);
+    }
+    return count;
+}
+
+BusNetwork::NodeList BusNetwork::planDirect(
+    Day day, const Stop& from, const Stop& to, Time arrive, Details details) const {
+
+    static thread_local QueryContext    context;
+    JourneyLeg                          leg;
+    if (!directConnections_.latestConnection(day, from, to, arrive, leg)) {
+        return NodeList{};
+    }
+    auto    count = fromJourney(Journey{leg}, context);
+    if (details != Details::steps) {
+        count = fromStepToEndList(context.nodes_, count);
+    }
+    return NodeList(context.nodes_.cbegin(), context.nodes_.cbegin() + count);
+}
+
+//  Label to leave the source of an edge with, from the label of its target; minusInf where the
+//  edge cannot be taken in time.
+struct BusNetwork::Combine {
+    Label operator()(const Label& label, const FootpathEdge& edge) const {
+        return Label{walkingRoute, label.time - adjust(label.route, walkingRoute) - edge.walk};
+    }
+    Label operator()(const Label& label, const TransitEdge& edge) const {
+        Time    toTime = label.time - adjust(label.route, edge.route);
         Time    fromTime = minusInf;
-        if (sectiont.routeid == walkingRouteId) {
-            fromTime = toTime - sectiont.diftime;
+        //  no search outside the service of the edge.
+        auto    times = context->edgeTimes(*network, day, edge.index);
+        if (times.first == times.second || toTime < *times.first) {
+            if (stats) {
+                stats->count(Counter::edgesPruned);
+            }
+        } else if (toTime >= *(times.second - 1)) {
+            fromTime = *(times.second - 1);
         } else {
-            auto    fromIt = std::lower_bound(
-                sectiont.stopTimes.crbegin(),
-                sectiont.stopTimes.crend(),
-                toTime,
-                std::greater<Time>{});
-            if (fromIt != sectiont.stopTimes.crend()) {
-                fromTime = *fromIt;
+            if (stats) {
+                stats->count(Counter::lowerBounds);
             }
+            fromTime = *(std::upper_bound(times.first, times.second, toTime) - 1);
+        }
+        //  the delayed times already have the trips of the calendar.
+        if (context->calendarDate_ != noDate && !context->delays_) {
+            fromTime = std::max(fromTime, network->latestService(edge.index, toTime, context->calendarDate_));
         }
-//        std::clog << stopt.routeid.linen << "." << stopt.routeid.routen << "\t";
-//        std::clog << toString(stopt.time) << "\t";
-//        std::clog << sectiont.routeid.linen << "." << sectiont.routeid.routen << "\t";
-//        std::clog << toString(fromTime) << std::endl;
+        return Label{edge.route, fromTime};
+    }
 
-        return StopTime{sectiont.routeid, fromTime};
-    };
+    const BusNetwork*   network;
+    QueryContext*       context;
+    Day                 day;
+    QueryStats*         stats;
+};
 
-    auto    edger = boost::edges(graph_);
-    std::for_each(edger.first, edger.second, [this, &w, day](const EdgeDesc& ed) {
-        const auto& section = graph_[ed];
-        if (section.routeid == walkingRouteId) {
-            w[ed] = SectionTime{
-                section.routeid,
-                lines_.walkingTimes().at(WalkingStep{section.from, section.to})};
+template <typename Edge>
+const Edge* BusNetwork::findEdge(
+    const QueryContext& context, const EdgeSet<Edge>& edges, const Combine& combine, VertexDesc pred, VertexDesc v) {
+
+    auto            er = edges.outEdges(pred);
+    auto            dpred = context.label(pred);
+    auto            route = context.label(v).route;
+    const Edge*     best = nullptr;
+    for (auto edge = er.first; edge != er.second; ++edge) {
+        if (edge->target != v) {
+            continue;
+        }
+        auto    label = combine(dpred, *edge);
+        if (label.route == route) {
+            return edge;
+        }
+        if (!best || QueryContext::LaterLabel{}(label, combine(dpred, *best))) {
+            best = edge;
+        }
+    }
+    return best;
+}
+
+void BusNetwork::relaxEdges(
+    QueryContext& context, VertexDesc s, bool walkOnly, const Combine& combine, QueryStats* stats) const {
+
+    auto    label = context.label(s);
+    auto    ter = transitEdges_.outEdges(s);
+    auto    fer = footpathEdges_.outEdges(s);
+    if (walkOnly) {
+        if (stats) {
+            stats->count(Counter::edgesPruned, ter.second - ter.first);
+        }
+        ter.first = ter.second;
+    }
+    while (ter.first != ter.second && fer.first != fer.second) {
+        if (ter.first->index < fer.first->index) {
+            relaxEdge(context, s, label, *ter.first++, combine, stats);
         } else {
-            w[ed] = SectionTime{
-                section.routeid,
-                lines_.getStopTimes(day, section.routeid, section.to)};
-        }
-//        std::clog << "weight " << ed << ": ";
-//        std::clog << toString(*w[ed].stopTimes.cbegin());
-//        std::clog << " ~ " << toString(*(w[ed].stopTimes.cend() - 1));
-//        std::clog << std::endl;
-    });
+            relaxEdge(context, s, label, *fer.first++, combine, stats);
+        }
+    }
+    for (; ter.first != ter.second; ++ter.first) {
+        relaxEdge(context, s, label, *ter.first, combine, stats);
+    }
+    for (; fer.first != fer.second; ++fer.first) {
+        relaxEdge(context, s, label, *fer.first, combine, stats);
+    }
+}
 
-    auto    u = stopMap_[to];
-    boost::dijkstra_shortest_paths(
-        graph_,
-        u,
-        boost::predecessor_map(boost::associative_property_map<PredecessorMap>(p)).
-            distance_map(boost::associative_property_map<DistanceMap>(d)).
-            weight_map(boost::associative_property_map<WeightMap>(w)).
-            distance_compare(compare).
-            distance_combine(combine).
-            distance_zero(StopTime{{}, arrive}).
-            distance_inf(StopTime{{}, minusInf}));
-
-    auto    edge_list = [this](VertexDesc u, VertexDesc v) {
-        std::vector<EdgeDesc>   rv;
-        auto                    er = boost::out_edges(u, graph_);
-        auto&                   g = graph_;
-        std::for_each(er.first, er.second, [&rv, v, &g](EdgeDesc e) {
-            if (boost::target(e, g) == v) {
-                rv.push_back(e);
-            }
-        });
-        return rv;
+template <typename Edge>
+void BusNetwork::relaxEdge(
+    QueryContext& context, VertexDesc s, const Label& label, const Edge& edge, const Combine& combine,
+    QueryStats* stats) {
+
+    auto    t = edge.target;
+    if (!context.discovered(t)) {
+        context.discover(t, Label{noRoute, minusInf});
+    }
+    if (context.finished_[t]) {
+        return;
+    }
+    //  vertices that cannot be left in time never enter the queue.
+    auto    tlabel = combine(label, edge);
+    if (QueryContext::LaterLabel{}(tlabel, context.labels_[t])) {
+        context.labels_[t] = tlabel;
+        context.predecessors_[t] = s;
+        context.queue_.push_or_update(t);
+        if (stats) {
+            stats->count(Counter::edgesRelaxed);
+        }
+    }
+}
+
+size_t BusNetwork::planDijkstra(QueryContext& context, Day day, Time arrive, QueryStats* stats) const {
+    search(context, day, arrive, false, stats);
+    if (context.origin_ == context.origins_.size()) {
+        return 0;
+    }
+    VertexDesc  root;
+    auto        count = reconstruct(context, day, context.origins_[context.origin_].vertex, root, stats);
+    //  the destination reached, through the shortest walk if it is there more than once.
+    const auto& targets = context.targets_;
+    context.target_ = targets.size();
+    for (size_t ix = 0; ix < targets.size(); ++ix) {
+        if (targets[ix].vertex == root &&
+            (context.target_ == targets.size() || targets[ix].walk < targets[context.target_].walk)) {
+
+            context.target_ = ix;
+        }
+    }
+    return count;
+}
+
+void BusNetwork::search(QueryContext& context, Day day, Time arrive, bool everyOrigin, QueryStats* stats) const {
+    const auto& origins = context.origins_;
+    const auto& targets = context.targets_;
+
+    ScopedTimer weightsTimer{stats, Phase::weights};
+    prepareDay(day);
+    weightsTimer.stop();
+
+    //  the snapshot is held by the context until its next query: the plan is reconstructed with
+    //  the delays it was searched with.
+    context.begin(*this);
+    context.snapshot_ = delays_.snapshot();
+    context.delays_ = context.snapshot_->appliesTo(day) ? context.snapshot_.get() : nullptr;
+    context.calendarDate_ = lines_.calendar().appliesTo(day) ? day.date() : noDate;
+
+    QueryContext::LaterLabel    compare;
+    Combine                     combine{this, &context, day, stats};
+
+    //  Dijkstra from the destinations, the same visit as boost::dijkstra_shortest_paths over a
+    //  4-ary heap, on the arrays of the context, relaxing walks and buses in the order of the out
+    //  edges.
+    ScopedTimer searchTimer{stats, Phase::search};
+    auto&       queue = context.queue_;
+    //  the destinations are stops of the query whatever the walk from them, with the same margin
+    //  to the last bus.
+    for (const auto& target: targets) {
+        Label   label{noRoute, arrive - target.walk};
+        if (!context.discovered(target.vertex)) {
+            context.discover(target.vertex, label);
+            queue.push(target.vertex);
+        } else if (compare(label, context.label(target.vertex))) {
+            context.labels_[target.vertex] = label;
+            queue.update(target.vertex);
+        }
+    }
+    size_t  originCount = 0;
+    for (const auto& origin: origins) {
+        if (context.originStamps_[origin.vertex] != context.epoch_) {
+            context.originStamps_[origin.vertex] = context.epoch_;
+            ++originCount;
+        }
+    }
+    //  leaving the place of the query, through an origin with the label 'label'.
+    auto    leave = [](const Access& origin, const Label& label) {
+        return origin.route == noRoute ? label.time : label.time - adjust(label.route, origin.route) - origin.walk;
     };
+    Time    best = minusInf;
+    context.origin_ = origins.size();
+    const auto& firstServices = firstServices_[day];
+    while (!queue.empty()) {
+        auto    s = queue.top();
+        //  labels are settled latest first: once every origin is, or no label left can leave
+        //  later than the best one, nothing else changes the plan.
+        if (!everyOrigin && context.label(s).time <= best) {
+            break;
+        }
+        queue.pop();
+        if (stats) {
+            stats->count(Counter::verticesSettled);
+        }
+        if (context.originStamps_[s] == context.epoch_) {
+            for (size_t ix = 0; !everyOrigin && ix < origins.size(); ++ix) {
+                if (origins[ix].vertex == s) {
+                    auto    time = leave(origins[ix], context.label(s));
+                    if (context.origin_ == origins.size() || time > best) {
+                        best = time;
+                        context.origin_ = ix;
+                    }
+                }
+            }
+            if (--originCount == 0) {
+                context.finished_[s] = true;
+                break;
+            }
+        }
+        //  before the first bus of the vertex, only walking is left (delays may move it earlier,
+        //  and the trips of the calendar are not counted).
+        auto    walkOnly =
+            !context.delays_ && context.calendarDate_ == noDate && context.label(s).time < firstServices[s];
+        relaxEdges(context, s, walkOnly, combine, stats);
+        context.finished_[s] = true;
+    }
+    while (!queue.empty()) {
+        queue.pop();
+    }
+    searchTimer.stop();
+}
+
+size_t BusNetwork::reconstruct(
+    QueryContext& context, Day day, VertexDesc v, VertexDesc& root, QueryStats* stats) const {
+
+    ScopedTimer reconstructionTimer{stats, Phase::reconstruction};
 
-    auto    v = stopMap_[from];
-    auto    dv = d.at(v);
-    Stop    stop = from;
-    Time    time = dv.time;
-    auto    pred = p[v];
-    while (pred != v && v != u) {
-        auto    dpred = d.at(pred);
-//        auto    e = boost::edge(pred, v, graph_);
-        auto    el = edge_list(pred, v);
-        auto    eit =
-            std::min_element(el.cbegin(), el.cend(), [pred, &dpred, &w, &combine, &compare](
-                EdgeDesc e1, EdgeDesc e2) {
-
-            return compare(combine(dpred, w[e1]), combine(dpred, w[e2]));
-        });
-        auto        section = graph_[*eit];
-        const auto& to = section.from;
+    const auto& delays = *context.snapshot_;
+    auto        delayed = context.delays_ != nullptr;
+    Combine     combine{this, &context, day, stats};
+
+    auto    arrive_time = [this, day, &delays, delayed](const Section& section, Time leave) {
         const auto& routeid = section.routeid;
-        rv.push_back(
-            Node{
-                {stop, time, lines_.getPlatform(routeid, stop)},
-                {to, lines_.getArriveTime(day, routeid, stop, time, to), lines_.getPlatform(routeid, to)},
-                routeid});
-        stop = graph_[pred];
-        time = dpred.time;
+        if (!delayed) {
+            return lines_.getRouteArriveTime(day, routeid, section.to, leave, section.from);
+        }
+        auto    planned = lines_.getRouteArriveTime(
+            day, routeid, section.to, delays.toPlanned(routeid, section.to, leave), section.from);
+        return delays.toActual(routeid, section.from, planned);
+    };
+
+    size_t  count = 0;
+    Time    time = context.label(v).time;
+    auto    pred = context.predecessor(v);
+    while (pred != v) {
+        auto&   node = context.node(count++);
+        node.from.stop = graph_[v];
+        node.from.time = time;
+        node.to.stop = graph_[pred];
+        if (context.label(v).route == walkingRoute) {
+            auto    edge = findEdge(context, footpathEdges_, combine, pred, v);
+            node.from.platform = Lines::walkingPlatform();
+            node.to.time = time + edge->walk;
+            node.to.platform = Lines::walkingPlatform();
+            node.routeid = walkingRouteId;
+        } else {
+            const auto& section = graph_[edges_[findEdge(context, transitEdges_, combine, pred, v)->index]];
+            node.from.platform = lines_.getRoutePlatform(section.routeid, node.from.stop);
+            node.to.time = arrive_time(section, time);
+            node.to.platform = lines_.getRoutePlatform(section.routeid, node.to.stop);
+            node.routeid = section.routeid;
+        }
+        time = context.label(pred).time;
         v = pred;
-        pred = p[v];
+        pred = context.predecessor(v);
     }
-//    rv.push_back(Node{RouteId{}, stop, time, {}});
+    root = v;
+    return count;
+}
 
-    if (details == Details::transfers) {
-        return fromStepToTransferList(rv);
+BusNetwork::Label BusNetwork::relabel(
+    const Combine& combine, const Label& label, VertexDesc s, VertexDesc t) const {
+
+    QueryContext::LaterLabel    compare;
+    Label                       rv{noRoute, minusInf};
+    auto    ter = transitEdges_.outEdges(s);
+    for (auto edge = ter.first; edge != ter.second; ++edge) {
+        if (edge->target == t && compare(combine(label, *edge), rv)) {
+            rv = combine(label, *edge);
+        }
     }
-    if (details == Details::ends) {
-        return fromStepToEndList(rv);
+    auto    fer = footpathEdges_.outEdges(s);
+    for (auto edge = fer.first; edge != fer.second; ++edge) {
+        if (edge->target == t && compare(combine(label, *edge), rv)) {
+            rv = combine(label, *edge);
+        }
     }
     return rv;
 }
 
-BusNetwork::Table BusNetwork::table(Day day, const Stop& from, const Stop& to, Details details) {
-    Table   rv;
-    auto    timeline = lines_.getStopTimes(day, to);
-    for (const auto& time: timeline) {
-        auto    nlist = planFromArrive(day, from, to, time, details);
-        if (!nlist.empty()) {
-            rv.push_back(nlist);
+BusNetwork::Table BusNetwork::planAlternatives(
+    Day day, const Stop& from, const Stop& to, Time arrive, size_t count, Details details,
+    QueryStats* stats) const {
+
+    static thread_local QueryContext    context;
+    ScopedAllocationCounter             allocationCounter{stats};
+    Table                               rv;
+    context.targets_.assign(1, Access{stopMap_.at(to), DifTime{0}, noRoute});
+    context.origins_.assign(1, Access{stopMap_.at(from), DifTime{0}, noRoute});
+    search(context, day, arrive, false, stats);
+    if (count == 0 || context.origin_ == context.origins_.size()) {
+        return rv;
+    }
+
+    //  the stops of the best plan, from the origin.
+    ScopedTimer reconstructionTimer{stats, Phase::reconstruction};
+    auto&   path = context.path_;
+    path.assign(1, context.origins_.front().vertex);
+    while (context.predecessor(path.back()) != path.back()) {
+        path.push_back(context.predecessor(path.back()));
+    }
+    for (auto v: path) {
+        context.pathStamps_[v] = context.epoch_;
+    }
+    //  Leaving the plan at path[at] for 'x', by edge 'index'. The stops up to 'at' are left
+    //  with new labels, the origin at 'leave'; the path of 'x' must not come back to them.
+    struct Deviation {
+        Time            leave;
+        size_t          at;
+        VertexDesc      x;
+        Label           label;
+    };
+    static thread_local std::vector<Deviation>  deviations;
+    deviations.clear();
+    Combine combine{this, &context, day, stats};
+    auto    loops = [&path](VertexDesc x, size_t at) {
+        while (context.pathStamps_[x] != context.epoch_) {
+            x = context.predecessor(x);
+        }
+        return static_cast<size_t>(std::find(path.cbegin(), path.cend(), x) - path.cbegin()) <= at;
+    };
+    for (size_t at = 0; at + 1 < path.size(); ++at) {
+        auto    u = path[at];
+        for (auto ix = inEdgeOffsets_[u]; ix < inEdgeOffsets_[u + 1]; ++ix) {
+            auto        index = inEdges_[ix];
+            auto        x = boost::source(edges_[index], graph_);
+            const auto& section = graph_[edges_[index]];
+            if (!context.discovered(x) || context.label(x).time == minusInf) {
+                continue;
+            }
+            auto    label = section.route == walkingRoute ?
+                combine(context.label(x), FootpathEdge{u, section.walk, index}) :
+                combine(context.label(x), TransitEdge{u, section.route, index});
+            if (label.time == minusInf || (x == path[at + 1] && label.route == context.label(u).route) ||
+                loops(x, at)) {
+
+                continue;
+            }
+            auto    leave = label;
+            for (auto j = at; j > 0 && leave.time != minusInf; --j) {
+                leave = relabel(combine, leave, path[j], path[j - 1]);
+            }
+            if (leave.time != minusInf) {
+                deviations.push_back(Deviation{leave.time, at, x, label});
+            }
+        }
+    }
+    std::stable_sort(deviations.begin(), deviations.end(), [](const Deviation& a, const Deviation& b) {
+        return a.leave > b.leave;
+    });
+    reconstructionTimer.stop();
+
+    //  what a plan is compared by: when it leaves, how many times it changes, its lines and the
+    //  stops where it changes, and the stops with their times of its final trip. Routes do not
+    //  overtake, so two plans sharing one of these on the same route end on the same trip.
+    struct Summary {
+        Time                                leave;
+        size_t                              changes;
+        std::vector<LineName>               lines;
+        Stops                               stops;
+        RouteId                             routeid;
+        std::vector<std::pair<Stop, Time>>  trip;
+    };
+    std::vector<Summary>    kept;
+    auto    keep = [&kept, &rv, details, stats](size_t nodeCount) {
+        Summary         summary{nodeCount ? context.nodes_.front().from.time : minusInf, 0, {}, {}, RouteId{}, {}};
+        size_t          legs = 0;
+        const RouteId*  previous = nullptr;
+        for (size_t i = 0; i < nodeCount; ++i) {
+            const auto& node = context.nodes_[i];
+            if (previous && node.routeid != *previous) {
+                summary.stops.push_back(node.from.stop);
+            }
+            if (node.routeid != walkingRouteId && (!previous || node.routeid != *previous)) {
+                summary.lines.push_back(node.routeid.linen);
+                ++legs;
+            }
+            if (node.routeid != walkingRouteId) {
+                if (summary.trip.empty() || node.routeid != summary.routeid ||
+                    summary.trip.back() != std::make_pair(node.from.stop, node.from.time)) {
+
+                    summary.routeid = node.routeid;
+                    summary.trip.assign(1, std::make_pair(node.from.stop, node.from.time));
+                }
+                summary.trip.emplace_back(node.to.stop, node.to.time);
+            }
+            previous = &node.routeid;
+        }
+        summary.changes = legs ? legs - 1 : 0;
+        std::sort(summary.trip.begin(), summary.trip.end());
+        auto    sameTrip = [&summary](const Summary& other) {
+            if (summary.trip.empty() || other.trip.empty() || other.routeid != summary.routeid) {
+                return false;
+            }
+            for (auto ita = summary.trip.cbegin(), itb = other.trip.cbegin();
+                 ita != summary.trip.cend() && itb != other.trip.cend();) {
+
+                if (*ita < *itb) {
+                    ++ita;
+                } else if (*itb < *ita) {
+                    ++itb;
+                } else {
+                    return true;
+                }
+            }
+            return false;
+        };
+        //  a line or a change stop of no plan kept, leaving not much earlier than the best plan.
+        auto    adds = [&kept, &summary]() {
+            if (kept.empty() || summary.leave < kept.front().leave - alternativeLoss) {
+                return false;
+            }
+            std::set<LineName>  lines;
+            std::set<Stop>      stops;
+            for (const auto& other: kept) {
+                lines.insert(other.lines.cbegin(), other.lines.cend());
+                stops.insert(other.stops.cbegin(), other.stops.cend());
+            }
+            return
+                !std::all_of(summary.lines.cbegin(), summary.lines.cend(), [&lines](const LineName& line) {
+                    return lines.count(line) != 0;
+                }) ||
+                !std::all_of(summary.stops.cbegin(), summary.stops.cend(), [&stops](const Stop& stop) {
+                    return stops.count(stop) != 0;
+                });
+        };
+        auto    dominated = false;
+        for (const auto& other: kept) {
+            if (sameTrip(other)) {
+                return;
+            }
+            dominated = dominated || (other.leave >= summary.leave && other.changes <= summary.changes);
+        }
+        if (dominated && !adds()) {
+            return;
+        }
+        kept.push_back(std::move(summary));
+        nodeCount = applyDetails(context.nodes_, nodeCount, details, stats);
+        rv.emplace_back(context.nodes_.cbegin(), context.nodes_.cbegin() + nodeCount);
+    };
+
+    VertexDesc  root;
+    keep(reconstruct(context, day, path.front(), root, stats));
+    //  each deviation is planned by relabelling the stops before it, then put back.
+    static thread_local std::vector<Label>  saved;
+    for (size_t k = 0; k < deviations.size() && rv.size() < count; ++k) {
+        const auto& deviation = deviations[k];
+        auto        at = deviation.at;
+        saved.clear();
+        for (size_t j = 0; j <= at; ++j) {
+            saved.push_back(context.labels_[path[j]]);
+        }
+        context.labels_[path[at]] = deviation.label;
+        context.predecessors_[path[at]] = deviation.x;
+        for (auto j = at; j > 0; --j) {
+            context.labels_[path[j - 1]] = relabel(combine, context.labels_[path[j]], path[j], path[j - 1]);
         }
+        keep(reconstruct(context, day, path.front(), root, stats));
+        for (size_t j = 0; j <= at; ++j) {
+            context.labels_[path[j]] = saved[j];
+        }
+        context.predecessors_[path[at]] = path[at + 1];
     }
+    return rv;
+}
+
+size_t BusNetwork::fromJourney(const Journey& journey, QueryContext& context) const {
+    size_t  count = 0;
+    for (const auto& leg: journey) {
+        const auto& routeid = leg.routeid;
+        for (size_t i = 1; i < leg.stops.size(); ++i) {
+            const auto& from = leg.stops[i - 1];
+            const auto& to = leg.stops[i];
+            auto&       node = context.node(count++);
+            node.from.stop = from.first;
+            node.from.time = from.second;
+            node.from.platform = lines_.getPlatform(routeid, from.first);
+            node.to.stop = to.first;
+            node.to.time = to.second;
+            node.to.platform = lines_.getPlatform(routeid, to.first);
+            node.routeid = routeid;
+        }
+    }
+    return count;
+}
+
+BusNetwork::Table BusNetwork::table(
+    Day day, const Stop& from, const Stop& to, Details details, QueryStats* stats) const {
+    auto    rv = planFromArrive(day, from, to, lines_.getStopTimes(day, to), details, stats);
+    rv.erase(std::remove_if(rv.begin(), rv.end(), [](const NodeList& nlist) {
+        return nlist.empty();
+    }), rv.end());
 
     std::stable_sort(rv.begin(), rv.end(), [](const NodeList& nl1, const NodeList& nl2) {
         assert(!nl1.empty());
@@ -206,37 +1152,29 @@ std::string BusNetwork::routeName(const RouteId& routeid) const {
     return lines_.getRouteDescription(routeid);
 }
 
-BusNetwork::NodeList BusNetwork::fromStepToTransferList(const BusNetwork::NodeList& stepList) {
-    if (stepList.empty()) {
-        return NodeList{};
+size_t BusNetwork::fromStepToTransferList(NodeList& nodes, size_t count) {
+    if (count == 0) {
+        return 0;
     }
 
-    NodeList    rv;
-    RouteId     routeid = stepList.front().routeid;
-    RoutePoint  from = stepList.front().from;
-    RoutePoint  to;
-    for (const auto& node: stepList) {
-        if (node.routeid != routeid) {
-            rv.push_back(Node{from, to, routeid});
-            from = node.from;
+    //  in place: merged nodes only move towards the front.
+    size_t  rv = 0;
+    for (size_t i = 1; i < count; ++i) {
+        if (nodes[i].routeid != nodes[rv].routeid) {
+            nodes[++rv] = nodes[i];
+        } else {
+            nodes[rv].to = nodes[i].to;
         }
-        routeid = node.routeid;
-        to = node.to;
     }
-    rv.push_back(Node{from, to, routeid});
-    return rv;
+    return rv + 1;
 }
 
-BusNetwork::NodeList BusNetwork::fromTransferToEndList(const BusNetwork::NodeList& transferList) {
-    if (transferList.empty()) {
-        return NodeList{};
+size_t BusNetwork::fromStepToEndList(NodeList& nodes, size_t count) {
+    if (count == 0) {
+        return 0;
     }
 
-    return NodeList{Node{transferList.front().from, transferList.back().to, RouteId{}}};
+    nodes.front().to = nodes[count - 1].to;
+    nodes.front().routeid = RouteId{};
+    return 1;
 }
-
-BusNetwork::NodeList BusNetwork::fromStepToEndList(const BusNetwork::NodeList& stepList) {
-    return fromTransferToEndList(stepList);
-}
-
-
@@ -2,15 +2,37 @@
 #ifndef BUS_NETWORK_HPP
 #define BUS_NETWORK_HPP
 
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <set>
 #include <utility>
 #include <vector>
 #include <boost/graph/adjacency_list.hpp>
+#include <boost/graph/detail/d_ary_heap.hpp>
 
+#include "connection_scan.hpp"
 #include "day.hpp"
+#include "delays.hpp"
 #include "details.hpp"
+#include "direct_connections.hpp"
+#include "engine.hpp"
+#include "journey.hpp"
 #include "lines.hpp"
+#include "spatial_index.hpp"
+#include "stats.hpp"
 #include "stop.hpp"
+#include "transfer_patterns.hpp"
+#include "trip_based.hpp"
+#include "../utility/lru_cache.hpp"
+
+//  How much earlier than the best plan an alternative may leave, and still be kept for the lines
+//  or change stops it adds.
+const DifTime   alternativeLoss = std::chrono::minutes{30};
 
 class BusNetwork {
 public:
@@ -26,8 +48,31 @@ public:
     };
     using NodeList = std::vector<Node>;
     using Table = std::vector<NodeList>;
+    //  Stops to reach, each by its own time.
+    using Deadlines = std::vector<std::pair<Stop, Time>>;
+    class QueryContext;
+    //  End of a journey: a stop, a group of stops any of which will do, or a position walked
+    //  from or to its nearest stops.
+    struct Place {
+        explicit Place(const Stop& stop): stops{stop}, position{0.0, 0.0} {
+        }
+        explicit Place(const Stops& stops): stops{stops}, position{0.0, 0.0} {
+        }
+        explicit Place(const Coordinates& position): stops{}, position{position} {
+        }
+
+        Stops       stops;      //  empty for a position
+        Coordinates position;
+    };
+
+    //  Numbering of the stops in the graph: lexical, or keeping the stops close in the network
+    //  close in memory.
+    enum class VertexOrder {
+        lexical,
+        locality
+    };
 
-    BusNetwork(Lines&& lines);
+    BusNetwork(Lines&& lines, VertexOrder order = VertexOrder::locality);
 
     LineNames getLineNames() const {
         return lines_.getLineNames();
@@ -35,45 +80,389 @@ public:
     RouteNames getRouteNames(const LineName& linen) const {
         return lines_.getRouteNames(linen);
     }
-    NodeList planFromArrive(Day day, const Stop& from, const Stop& to, Time arrive, Details details);
-    Table table(Day day, const Stop& from, const Stop& to, Details details);
+    const Lines& lines() const {
+        return lines_;
+    }
+    DelayOverlay& delays() {
+        return delays_;
+    }
+    Engine engine() const {
+        return engine_;
+    }
+    //  Whether 'stop' is served by any line.
+    bool hasStop(const Stop& stop) const {
+        return stopMap_.count(stop) != 0;
+    }
+    //  Select the engine of planFromArrive(), computing its data unless readIndex() read it:
+    //  the transfers of the trip based engine for every day of the week, or the transfer
+    //  patterns. The connections of the connection scan engine are always computed.
+    void setEngine(Engine engine, unsigned threads = 0);
+    //  Select 'engine' with the data written by writeIndex(). Throws std::runtime_error if it
+    //  was computed for another timetable.
+    void readIndex(Engine engine, std::istream& is);
+    void writeIndex(std::ostream& os) const;
+    //  Bytes used by the data of the current engine.
+    size_t indexMemoryUsage() const;
+    //  Make planFromArrive() answer with a journey without change whenever there is one, even
+    //  if a journey with changes leaves later.
+    void preferDirect(bool prefer) {
+        preferDirect_ = prefer;
+        clearCache();
+    }
+    //  Walk from or to the 'count' nearest stops within 'radius' metres of a position, at
+    //  'speed' km/h.
+    void setAccess(size_t count, double radius, double speed) {
+        accessCount_ = count;
+        accessRadius_ = radius;
+        walkingSpeed_ = speed;
+    }
+    //  Keep the last 'capacity' plans between stops asked for, each for 'ttl' at most, and answer
+    //  the same query again without searching. Queries are planned for the start of their
+    //  'bucket' of arrival times, so that the ones close in time share a plan. Plans are dropped
+    //  when delays are published or the engine changes. A capacity of 0 keeps none.
+    void setCache(size_t capacity, std::chrono::seconds ttl, DifTime bucket = DifTime{1});
+    unsigned long cacheHits() const {
+        return planCache_ ? planCache_->hits() : 0;
+    }
+    unsigned long cacheMisses() const {
+        return planCache_ ? planCache_->misses() : 0;
+    }
+    //  Queries only read the network, they may run concurrently. Those without a context use one
+    //  of the calling thread.
+    NodeList planFromArrive(
+        Day day, const Stop& from, const Stop& to, Time arrive, Details details, QueryStats* stats = nullptr) const;
+    //  Call function(node) for every node of the plan, in order. The nodes belong to 'context'
+    //  and are only valid during the call. With a context that already served a query on this
+    //  network, the graph search does not allocate.
+    template <typename Function>
+    void planFromArrive(
+        QueryContext& context, Day day, const Stop& from, const Stop& to, Time arrive, Details details,
+        Function function, QueryStats* stats = nullptr) const;
+    //  Plans arriving by each of 'arrives', in order, empty where there is none. The connection
+    //  scan engine answers them together, the other ones one by one.
+    Table planFromArrive(
+        Day day, const Stop& from, const Stop& to, const std::vector<Time>& arrives, Details details,
+        QueryStats* stats = nullptr) const;
+    //  Plans from each of 'froms' to 'to' arriving by 'arrive', in order, empty where there is
+    //  none. The graph search answers all those not in the cache with one search from 'to', the
+    //  other engines one by one. Throws std::out_of_range for an unknown stop.
+    Table planFromArrive(
+        Day day, const Stops& froms, const Stop& to, Time arrive, Details details, QueryStats* stats = nullptr) const;
+    //  Plan between places: all the stops of a place are searched from at once, at the cost of
+    //  a single stop, with the graph search whatever the engine. A walk from or to a position has the position as stop,
+    //  as written by toString(Coordinates). Throws std::out_of_range if there is no stop near.
+    NodeList planFromArrive(
+        Day day, const Place& from, const Place& to, Time arrive, Details details, QueryStats* stats = nullptr) const;
+    //  Plan from 'from' to whichever stop of 'tos' it can leave the latest for, with the graph
+    //  search whatever the engine. Throws std::out_of_range for an unknown stop.
+    NodeList planFromArrive(
+        Day day, const Stop& from, const Deadlines& tos, Details details, QueryStats* stats = nullptr) const;
+    //  Up to 'count' plans arriving by 'arrive', the best one first, from a single graph search
+    //  whatever the engine. The other ones leave the best plan at one of its stops by another
+    //  bus or walk, then go on the best way the search found from there; the latest leaving are
+    //  kept, unless one ends on the trip of a plan kept before, or a plan kept before leaves no
+    //  earlier with no more changes and it adds no line nor change stop to the plans kept, or
+    //  leaves alternativeLoss earlier than the best one. Throws std::out_of_range for an unknown
+    //  stop.
+    Table planAlternatives(
+        Day day, const Stop& from, const Stop& to, Time arrive, size_t count, Details details,
+        QueryStats* stats = nullptr) const;
+    Table table(Day day, const Stop& from, const Stop& to, Details details, QueryStats* stats = nullptr) const;
+    //  Latest journey without change, empty if there is none.
+    NodeList planDirect(Day day, const Stop& from, const Stop& to, Time arrive, Details details) const;
 
     std::string routeName(const RouteId& routeid) const;
+    //  Mean distance between the numbers of the ends of an edge: how far apart in memory the
+    //  search jumps.
+    double meanEdgeSpan() const;
 private:
+    struct PlanKey {
+        bool operator==(const PlanKey& other) const {
+            return
+                from == other.from && to == other.to && day == other.day && date == other.date &&
+                arrive == other.arrive && details == other.details;
+        }
 
-    struct Section {
-        RouteId routeid;
         Stop    from;
         Stop    to;
+        size_t  day;
+        Date    date;
+        Time    arrive;
+        Details details;
     };
-    struct StopTime {
-        RouteId routeid;
-        Time    time;
+    struct PlanKeyHash {
+        size_t operator()(const PlanKey& key) const;
     };
-    struct SectionTime {
-        SectionTime(RouteId rid, TimeLine tl): routeid{std::move(rid)}, stopTimes{std::move(tl)}, diftime{} {
-        }
-        SectionTime(RouteId rid, DifTime dt): routeid{std::move(rid)}, stopTimes{}, diftime{std::move(dt)} {
-        }
-        SectionTime() = default;
+    using PlanCache = Utility::LruCache<PlanKey, NodeList, PlanKeyHash>;
 
-        RouteId     routeid;
-        TimeLine    stopTimes;
-        DifTime     diftime;
+
+    //  Routes are numbered for the search, walking and the destination have their own numbers.
+    static const std::uint32_t  noRoute = 0;
+    static const std::uint32_t  walkingRoute = 1;
+
+    struct Section {
+        RouteId         routeid;
+        Stop            from;
+        Stop            to;
+        std::uint32_t   route;
+        size_t          index;      //  of the edge, into edgeOffsets_
+        DifTime         walk;       //  walking sections only
     };
+    //  Latest time to leave a stop, and the route taken there.
+    struct Label {
+        std::uint32_t   route;
+        Time            time;
+    };
+    //  the out edges of a vertex are contiguous, in lexical order of their targets.
     using Graph = boost::adjacency_list<
-        boost::multisetS, boost::vecS, boost::directedS, Stop, Section>;
+        boost::vecS, boost::vecS, boost::directedS, Stop, Section>;
     using VertexDesc = boost::graph_traits<Graph>::vertex_descriptor;
     using EdgeDesc = boost::graph_traits<Graph>::edge_descriptor;
+    //  The out edges again, by kind: the search reads only what it needs of each and never tests
+    //  the kind of an edge. Both keep the index of the edge, the order the search relaxes them in.
+    struct TransitEdge {
+        VertexDesc      target;
+        std::uint32_t   route;
+        std::uint32_t   index;      //  into edges_ and edgeOffsets_
+    };
+    struct FootpathEdge {
+        VertexDesc      target;
+        DifTime         walk;
+        std::uint32_t   index;      //  into edges_
+    };
+    //  Edges of one kind, the ones of vertex v from offsets[v] to offsets[v + 1].
+    template <typename Edge>
+    struct EdgeSet {
+        std::pair<const Edge*, const Edge*> outEdges(VertexDesc v) const {
+            return std::make_pair(edges.data() + offsets[v], edges.data() + offsets[v + 1]);
+        }
 
+        std::vector<size_t> offsets;
+        std::vector<Edge>   edges;
+    };
+    struct Combine;
+    //  A vertex where the search starts or ends, with the walk to or from the place of the
+    //  query: route walkingRoute, or noRoute for the stop of the query itself.
+    struct Access {
+        VertexDesc      vertex;
+        DifTime         walk;
+        std::uint32_t   route;
+    };
+    using Accesses = std::vector<Access>;
+
+    //  Time to change from the route of a label to another one. It is counted from the departure
+    //  of the label (see transferTime).
+    static DifTime adjust(std::uint32_t routea, std::uint32_t routeb);
     void init();
-    static NodeList fromStepToTransferList(const NodeList& stepList);
-    static NodeList fromTransferToEndList(const NodeList& transferList);
-    static NodeList fromStepToEndList(const NodeList& stepList);
+    //  Pairs of stop indices linked by a step or a walk.
+    using Links = std::vector<std::pair<size_t, size_t>>;
+    //  Stop indices in the order to number them, keeping linked stops close.
+    static std::vector<size_t> localityOrder(size_t stopCount, const Links& links);
+    //  Compute the stop times of the edges and the service bounds of the vertices on 'day', once.
+    void prepareDay(Day day) const;
+    //  Plan into the nodes of 'context', returning how many there are.
+    size_t plan(
+        QueryContext& context, Day day, const Stop& from, const Stop& to, Time arrive, Details details,
+        QueryStats* stats) const;
+    //  Latest plan from the origins of 'context' to its targets, with the origin and the target
+    //  taken.
+    size_t planDijkstra(QueryContext& context, Day day, Time arrive, QueryStats* stats) const;
+    //  Search from the targets of 'context' until the best of its origins is settled, or every
+    //  one of them.
+    void search(QueryContext& context, Day day, Time arrive, bool everyOrigin, QueryStats* stats) const;
+    //  The plan from 'v', settled by the last search, into the nodes of 'context'; 'root'
+    //  receives the target it ends at.
+    size_t reconstruct(QueryContext& context, Day day, VertexDesc v, VertexDesc& root, QueryStats* stats) const;
+    //  The vertices of 'place' into 'accesses'.
+    void access(const Place& place, Accesses& accesses) const;
+    //  Relax the edges leaving 's', queueing the vertices they improve: the walks, and the buses
+    //  unless 'walkOnly'. Equal labels are resolved by the order of the out edges, so both kinds
+    //  are taken in it.
+    void relaxEdges(
+        QueryContext& context, VertexDesc s, bool walkOnly, const Combine& combine, QueryStats* stats) const;
+    template <typename Edge>
+    static void relaxEdge(
+        QueryContext& context, VertexDesc s, const Label& label, const Edge& edge, const Combine& combine,
+        QueryStats* stats);
+    //  The edge of 'edges' from 'pred' to 'v' that set the label of v, else the best of them.
+    template <typename Edge>
+    static const Edge* findEdge(
+        const QueryContext& context, const EdgeSet<Edge>& edges, const Combine& combine, VertexDesc pred,
+        VertexDesc v);
+    //  Latest label to leave 't' by the edges from 's' to it, 's' being left with 'label'.
+    Label relabel(const Combine& combine, const Label& label, VertexDesc s, VertexDesc t) const;
+    //  Key of a query in the cache, with the start of the bucket of its arrival time.
+    PlanKey planKey(Day day, const Stop& from, const Stop& to, Time arrive, Details details) const;
+    //  Only the graph search knows about delays and the calendar: the other engines fall back to
+    //  it on such days, with its changes (see transferTime).
+    bool needsGraph(Day day) const {
+        return delays_.snapshot()->appliesTo(day) || lines_.calendar().appliesTo(day);
+    }
+    //  Latest stop time of edge 'index' by 'time' of a calendar service running on 'date',
+    //  minusInf if there is none.
+    Time latestService(size_t index, Time time, Date date) const;
+    //  Stop to stop plan, from the cache if it has it.
+    size_t cachedPlan(
+        QueryContext& context, Day day, const Stop& from, const Stop& to, Time arrive, Details details,
+        QueryStats* stats) const;
+    void clearCache() {
+        if (planCache_) {
+            planCache_->clear();
+        }
+    }
+    size_t fromJourney(const Journey& journey, QueryContext& context) const;
+    static size_t applyDetails(NodeList& nodes, size_t count, Details details, QueryStats* stats);
+    static size_t fromStepToTransferList(NodeList& nodes, size_t count);
+    static size_t fromStepToEndList(NodeList& nodes, size_t count);
 
     Lines                       lines_;
+    DirectConnections           directConnections_;
+    DelayOverlay                delays_;
     Graph                       graph_;
     std::map<Stop, VertexDesc>  stopMap_;
+    Engine                      engine_;
+    bool                        preferDirect_;
+    std::array<std::unique_ptr<TripBased>, 7>   tripBased_;
+    std::unique_ptr<TransferPatterns>           transferPatterns_;
+    std::array<std::unique_ptr<ConnectionScan>, 7>  connectionScan_;
+    std::vector<EdgeDesc>                       edges_;     //  by index
+    EdgeSet<TransitEdge>                        transitEdges_;
+    EdgeSet<FootpathEdge>                       footpathEdges_;
+    //  Edges reaching each vertex, by index: those of vertex v from inEdgeOffsets_[v] to
+    //  inEdgeOffsets_[v + 1]. The alternatives to a plan leave it by them.
+    std::vector<size_t>                         inEdgeOffsets_;
+    std::vector<std::uint32_t>                  inEdges_;
+    //  stops with coordinates, and their vertices by point of the index.
+    SpatialIndex                                stopIndex_;
+    std::vector<VertexDesc>                     indexedStops_;
+    size_t                                      accessCount_;
+    double                                      accessRadius_;
+    double                                      walkingSpeed_;
+    std::unique_ptr<PlanCache>                  planCache_;
+    DifTime                                     cacheBucket_;
+    //  Stop times of the edges by day, the ones of edge i start at edgeOffsets_[day][i]; being
+    //  sorted, their ends are the first and last service of the edge. Each day is computed by its
+    //  first query, with the first service of the bus edges of every vertex.
+    mutable std::array<std::once_flag, 7>               dayFlags_;
+    mutable std::array<std::vector<size_t>, 7>          edgeOffsets_;
+    mutable std::array<std::vector<Time>, 7>            edgeTimes_;
+    mutable std::array<std::vector<Time>, 7>            firstServices_;     //  by vertex
+    //  Stop times of the trips of the calendar services by edge, whatever the day, the same way,
+    //  with their service. Empty without a calendar.
+    std::vector<size_t>                         serviceOffsets_;
+    std::vector<Time>                           serviceTimes_;
+    std::vector<ServiceId>                      serviceIds_;
 };
 
+//  Scratch space of the queries of one thread. Labels and predecessors are stamped with the
+//  query that wrote them, so nothing is cleared between queries, and no buffer ever shrinks:
+//  once a context has served a query on a network, the next ones reuse its memory.
+class BusNetwork::QueryContext {
+public:
+    QueryContext();
+    QueryContext(const QueryContext&) = delete;
+    QueryContext& operator=(const QueryContext&) = delete;
+
+private:
+    friend class BusNetwork;
+
+    //  Property maps over the context, for the queue.
+    struct LabelMap {
+        using key_type = VertexDesc;
+        using value_type = Label;
+        using reference = Label;
+        using category = boost::readable_property_map_tag;
+
+        Label get(VertexDesc v) const {
+            return context->label(v);
+        }
+        friend Label get(const LabelMap& map, VertexDesc v) {
+            return map.get(v);
+        }
+
+        const QueryContext* context;
+    };
+    struct QueueIndexMap {
+        using key_type = VertexDesc;
+        using value_type = size_t;
+        using reference = size_t&;
+        using category = boost::lvalue_property_map_tag;
+
+        size_t& operator[](VertexDesc v) const {
+            return context->queueIndex_[v];
+        }
+        friend size_t get(const QueueIndexMap& map, VertexDesc v) {
+            return map[v];
+        }
+        friend void put(const QueueIndexMap& map, VertexDesc v, size_t index) {
+            map[v] = index;
+        }
+
+        QueryContext*   context;
+    };
+    struct LaterLabel {
+        bool operator()(const Label& labela, const Label& labelb) const;
+    };
+    using Queue = boost::d_ary_heap_indirect<VertexDesc, 4, QueueIndexMap, LabelMap, LaterLabel>;
+
+    //  Start a query on 'network'.
+    void begin(const BusNetwork& network);
+    bool discovered(VertexDesc v) const {
+        return stamps_[v] == epoch_;
+    }
+    void discover(VertexDesc v, Label label) {
+        stamps_[v] = epoch_;
+        labels_[v] = label;
+        predecessors_[v] = v;
+        finished_[v] = false;
+    }
+    Label label(VertexDesc v) const {
+        return discovered(v) ? labels_[v] : Label{noRoute, minusInf};
+    }
+    VertexDesc predecessor(VertexDesc v) const {
+        return discovered(v) ? predecessors_[v] : v;
+    }
+    //  Stop times of the edge on 'day', with the delays of the query applied if there are any.
+    std::pair<const Time*, const Time*> edgeTimes(const BusNetwork& network, Day day, size_t index);
+    Node& node(size_t ix) {
+        if (ix == nodes_.size()) {
+            nodes_.emplace_back();
+        }
+        return nodes_[ix];
+    }
+
+    const BusNetwork*           network_;
+    std::uint32_t               epoch_;
+    std::vector<std::uint32_t>  stamps_;
+    std::vector<Label>          labels_;
+    std::vector<VertexDesc>     predecessors_;
+    std::vector<bool>           finished_;
+    std::vector<size_t>         queueIndex_;
+    Queue                       queue_;
+    std::shared_ptr<const DelaySnapshot>    snapshot_;  //  of the last search
+    const DelaySnapshot*        delays_;    //  the snapshot if it applies to the query
+    Date                        calendarDate_;  //  of the services running, or noDate
+    std::vector<std::uint32_t>  delayedStamps_;
+    std::vector<TimeLine>       delayedTimes_;
+    NodeList                    nodes_;
+    Accesses                    origins_;
+    Accesses                    targets_;
+    std::vector<std::uint32_t>  originStamps_;
+    std::vector<std::uint32_t>  pathStamps_;    //  vertices of the plan the alternatives leave
+    std::vector<VertexDesc>     path_;
+    size_t                      origin_;    //  taken, into origins_, or origins_.size()
+    size_t                      target_;
+};
+
+template <typename Function>
+void BusNetwork::planFromArrive(
+    QueryContext& context, Day day, const Stop& from, const Stop& to, Time arrive, Details details,
+    Function function, QueryStats* stats) const {
+
+    auto    count = cachedPlan(context, day, from, to, arrive, details, stats);
+    for (size_t i = 0; i < count; ++i) {
+        function(static_cast<const Node&>(context.nodes_[i]));
+    }
+}
+
 #endif // BUS_NETWORK_HPP
@@ -0,0 +1,66 @@
+#   Network model and search, shared by busplan and the tools built on top of it.
+
+SOURCES += \
+    $$PWD/bus_network.cpp \
+    $$PWD/calendar.cpp \
+    $$PWD/config.cpp \
+    $$PWD/connection_scan.cpp \
+    $$PWD/../utility/ini_doc.cpp \
+    $$PWD/day.cpp \
+    $$PWD/delays.cpp \
+    $$PWD/details.cpp \
+    $$PWD/direct_connections.cpp \
+    $$PWD/engine.cpp \
+    $$PWD/federation.cpp \
+    $$PWD/line.cpp \
+    $$PWD/lines.cpp \
+    $$PWD/options.cpp \
+    $$PWD/query_log.cpp \
+    $$PWD/route.cpp \
+    $$PWD/stats.cpp \
+    $$PWD/transfer_patterns.cpp \
+    $$PWD/trip_based.cpp \
+    $$PWD/trip_table.cpp \
+    $$PWD/fragment.cpp \
+    $$PWD/schedule.cpp \
+    $$PWD/spatial_index.cpp \
+    $$PWD/static_network.cpp \
+    $$PWD/time_line.cpp \
+    $$PWD/walking.cpp
+
+HEADERS += \
+    $$PWD/lines.hpp \
+    $$PWD/bus_network.hpp \
+    $$PWD/calendar.hpp \
+    $$PWD/walking.hpp \
+    $$PWD/time.hpp \
+    $$PWD/stop.hpp \
+    $$PWD/config.hpp \
+    $$PWD/connection_scan.hpp \
+    $$PWD/route.hpp \
+    $$PWD/line.hpp \
+    $$PWD/schedule.hpp \
+    $$PWD/spatial_index.hpp \
+    $$PWD/static_network.hpp \
+    $$PWD/algorithm.hpp \
+    $$PWD/time_line.hpp \
+    $$PWD/../utility/literal.hpp \
+    $$PWD/../utility/ini_doc.hpp \
+    $$PWD/day.hpp \
+    $$PWD/delays.hpp \
+    $$PWD/details.hpp \
+    $$PWD/direct_connections.hpp \
+    $$PWD/engine.hpp \
+    $$PWD/federation.hpp \
+    $$PWD/fragment.hpp \
+    $$PWD/journey.hpp \
+    $$PWD/options.hpp \
+    $$PWD/query_log.hpp \
+    $$PWD/stats.hpp \
+    $$PWD/transfer_patterns.hpp \
+    $$PWD/trip_based.hpp \
+    $$PWD/trip_table.hpp \
+    $$PWD/../utility/arena.hpp \
+    $$PWD/../utility/binary_io.hpp \
+    $$PWD/../utility/histogram.hpp \
+    $$PWD/../utility/lru_cache.hpp
@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "calendar.hpp"
+
+ServiceId ServiceCalendar::add(Service service) {
+    if (services_.size() >= std::numeric_limits<ServiceId>::max() - 1u) {
+        throw std::length_error("Too many services");
+    }
+    services_.push_back(std::move(service));
+    return static_cast<ServiceId>(services_.size());
+}
+
+ServiceId ServiceCalendar::find(const std::string& name) const {
+    auto    it = std::find_if(services_.cbegin(), services_.cend(), [&name](const Service& service) {
+        return service.name == name;
+    });
+    if (it == services_.cend()) {
+        throw std::out_of_range(std::string{"Unknown service "}.append(name));
+    }
+    return static_cast<ServiceId>(it - services_.cbegin() + 1);
+}
+
+void ServiceCalendar::compile() {
+    //  the period runs from the first date of any service to the last one.
+    auto    first = std::numeric_limits<Date>::max();
+    auto    last = std::numeric_limits<Date>::min();
+    for (const auto& service: services_) {
+        first = std::min(first, service.first);
+        last = std::max(last, service.last);
+        for (auto date: service.added) {
+            first = std::min(first, date);
+            last = std::max(last, date);
+        }
+    }
+    first_ = first;
+    dayCount_ = last >= first ? static_cast<size_t>(last - first + 1) : 0;
+    words_ = (dayCount_ + 63) / 64;
+    bits_.assign(services_.size() * words_, 0);
+
+    for (size_t id = 0; id < services_.size(); ++id) {
+        const auto& service = services_[id];
+        auto        words = bits_.data() + id * words_;
+        auto        set = [this, words](Date date, bool value) {
+            auto    ix = static_cast<size_t>(date - first_);
+            auto    bit = std::uint64_t{1} << (ix % 64);
+            words[ix / 64] = value ? words[ix / 64] | bit : words[ix / 64] & ~bit;
+        };
+        for (auto date = service.first; date <= service.last; ++date) {
+            if ((service.weekdays >> size_t{Day::fromDate(date)}) & 1) {
+                set(date, true);
+            }
+        }
+        for (auto date: service.added) {
+            set(date, true);
+        }
+        for (auto date: service.removed) {
+            if (date >= first_ && date - first_ < static_cast<Date>(dayCount_)) {
+                set(date, false);
+            }
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#ifndef CALENDAR_HPP
+#define CALENDAR_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "day.hpp"
+#include "time.hpp"
+
+//  Service 0 is the one of the weekday timetables, the other ones come from the calendar.
+using ServiceId = std::uint16_t;
+const ServiceId weekdayService = 0;
+//  Times of the trips of calendar services at a stop, by time.
+using ServiceTimes = std::vector<std::pair<Time, ServiceId>>;
+
+//  Dates on which the trips of each service run: every day of a weekday mask within a
+//  validity range, with dates added and removed. Once compiled, each service is a bitset
+//  over the period of the whole calendar, so whether a trip runs on a date is a bit test.
+class ServiceCalendar {
+public:
+    struct Service {
+        std::string         name;
+        Date                first;
+        Date                last;
+        std::uint8_t        weekdays;   //  bit d for Day{d}
+        std::vector<Date>   added;
+        std::vector<Date>   removed;
+    };
+
+    ServiceCalendar(): services_{}, first_{0}, dayCount_{0}, words_{0}, bits_{} {
+    }
+
+    bool empty() const {
+        return services_.empty();
+    }
+    //  Services are numbered from 1 to size().
+    size_t size() const {
+        return services_.size();
+    }
+    //  Whether the services of the calendar run on 'day' or not: only known for a date.
+    bool appliesTo(Day day) const {
+        return !empty() && day.hasDate();
+    }
+    //  compile() once every service is added, before runs() is called.
+    ServiceId add(Service service);
+    void compile();
+    //  Throws std::out_of_range for an unknown service.
+    ServiceId find(const std::string& name) const;
+    const Service& service(ServiceId id) const {
+        return services_.at(id - 1);
+    }
+
+    bool runs(ServiceId id, Day day) const {
+        return day.hasDate() && runs(id, day.date());
+    }
+    bool runs(ServiceId id, Date date) const {
+        assert(bits_.size() == services_.size() * words_);
+        auto    ix = static_cast<std::int64_t>(date) - first_;
+        if (id == weekdayService || ix < 0 || ix >= static_cast<std::int64_t>(dayCount_)) {
+            return id == weekdayService;
+        }
+        return (bits_[(id - 1) * words_ + ix / 64] >> (ix % 64)) & 1;
+    }
+
+private:
+    std::vector<Service>        services_;
+    Date                        first_;
+    size_t                      dayCount_;
+    size_t                      words_;     //  per service
+    std::vector<std::uint64_t>  bits_;
+};
+
+#endif // CALENDAR_HPP
@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <cassert>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 
 #include "config.hpp"
@@ -8,11 +10,13 @@
 #include "walking.hpp"
 
 
-void read(const Utility::IniDoc::Doc&, const std::string&, Line&);
-void read(const Utility::IniDoc::Doc&, const std::string&, Route&);
+void read(const Utility::IniDoc::Doc&, const std::string&, const ServiceCalendar&, Line&);
+void read(const Utility::IniDoc::Doc&, const std::string&, const ServiceCalendar&, Route&);
 void read(const Utility::IniDoc::Doc&, const std::string&, const Stops&, DifTimeLines&dtlines);
 void read(const Utility::IniDoc::Doc&, const std::string&, const Stops&, const DifTimeLines&, Schedule&);
 void read(const Utility::IniDoc::Doc& cfg, WalkingTimes& wt);
+void read(const Utility::IniDoc::Doc& cfg, StopCoordinates& sc);
+void read(const Utility::IniDoc::Doc& cfg, ServiceCalendar& calendar);
 
 inline std::string strip(std::string str) {
     char    c = ' ';
@@ -25,6 +29,27 @@ inline std::string strip(std::string str) {
     return str;
 }
 
+void getConfig(Utility::IniDoc& config, const std::string& fname) {
+    std::ifstream   cfgf(fname);
+    if (!cfgf.is_open()) {
+        throw std::runtime_error(
+            std::string{"Unable to open \""}.append(fname).append("\""));
+    }
+    cfgf >> config;
+}
+
+void resolveImports(Utility::IniDoc& config, const std::string& dir) {
+    if (config.doc().at("").count("imports")) {
+        const auto& importList = config.doc().at("").at("imports").items();
+        for (const auto& importstr: importList) {
+            Utility::IniDoc iconfig;
+            getConfig(iconfig, dir.empty() ? std::string{importstr} : dir + "/" + importstr);
+            resolveImports(iconfig, dir);
+            config.merge(iconfig, Utility::IniDoc::DuplicateAction::combineProperty);
+        }
+    }
+}
+
 void read(const Utility::IniDoc::Doc &cfg, Lines& lines, StopDescriptions& sds) {
     const auto& ssection = cfg.at("stops");
     for (const auto& sline: ssection) {
@@ -35,30 +60,68 @@ void read(const Utility::IniDoc::Doc &cfg, Lines& lines, StopDescriptions& sds)
             std::forward_as_tuple(sdlist.cbegin(), sdlist.cend()));
     }
 
+    read(cfg, lines.calendar());
     const auto& lineslist = cfg.at("").at("lines").items();
     for (const auto& lstr: lineslist) {
 //        std::cout << "Line: " << lstr << std::endl;
 
         auto&   line = lines.addLine(lstr);
         try {
-            read(cfg, lstr, line);
+            read(cfg, lstr, lines.calendar(), line);
         } catch (const std::out_of_range&) {
             std::cerr << "Error in line: " << lstr << std::endl;
             lines.removeLine(lstr);
         }
     }
 
+    read(cfg, lines.stopCoordinates());
     read(cfg, lines.walkingTimes());
+    //  walks between the stops within "walking-radius" metres, unless given in [walking].
+    const auto& root = cfg.at("");
+    if (root.count("walking-radius")) {
+        generateWalkingTimes(
+            lines.walkingTimes(), lines.stopCoordinates(), lines.getStopSet(),
+            std::stod(root.at("walking-radius").string()), walkingSpeed(cfg));
+    }
+    //  chains of walks up to "max-walk" become single walks.
+    if (root.count("max-walk")) {
+        closeWalkingTimes(lines.walkingTimes(), toDifTime(root.at("max-walk").string()));
+    }
+    //  "compress-timetables=yes": the compressed model alone is copied into a new arena, the
+    //  expanded tables go with the old one.
+    if (root.count("compress-timetables") && root.at("compress-timetables").string() == "yes") {
+        lines.compress();
+        lines = Lines{lines};
+    }
+}
+
+void read(const Utility::IniDoc::Doc& cfg, StopGroups& groups) {
+    const auto gsectionIt = cfg.find("groups");
+    if (gsectionIt == cfg.cend()) {
+        return;
+    }
+    for (const auto& gline: gsectionIt->second) {
+        const auto& stops = gline.second.items();
+        groups.emplace(
+            std::piecewise_construct,
+            std::forward_as_tuple(gline.first),
+            std::forward_as_tuple(stops.cbegin(), stops.cend()));
+    }
+}
+
+double walkingSpeed(const Utility::IniDoc::Doc& cfg) {
+    const auto& root = cfg.at("");
+    return root.count("walking-speed") ? std::stod(root.at("walking-speed").string()) : defaultWalkingSpeed;
 }
 
-void read(const Utility::IniDoc::Doc& cfg, const std::string& sname, Line& line) {
+void read(const Utility::IniDoc::Doc& cfg, const std::string& sname, const ServiceCalendar& calendar, Line& line) {
     const auto& routelist = cfg.at(sname).at("routes").items();
     for (const auto& rstr: routelist) {
 //        std::cout << "    Route: " << rstr << std::endl;
 
         auto&   route = line.addRoute(rstr);
         try {
-            read(cfg, sname + "." + rstr, route);
+            read(cfg, sname + "." + rstr, calendar, route);
         } catch (const std::out_of_range&) {
             std::cerr << "Error in route: " << rstr << " (" << sname << ")" << std::endl;
             line.removeRoute(rstr);
@@ -66,7 +129,7 @@ void read(const Utility::IniDoc::Doc& cfg, const std::string& sname, Line& line)
     }
 }
 
-void read(const Utility::IniDoc::Doc& cfg, const std::string& sname, Route& route) {
+void read(const Utility::IniDoc::Doc& cfg, const std::string& sname, const ServiceCalendar& calendar, Route& route) {
     route.setDescription(cfg.at(sname).at("description").string());
 
 //    std::cout << "        Stops: " << cfg.at(sname).at("stops").string() << std::endl;
@@ -106,6 +169,15 @@ void read(const Utility::IniDoc::Doc& cfg, const std::string& sname, Route& rout
             std::cerr << "Error in day: " << day << "(" << sname << ")" << std::endl;
         }
     }
+    //  the timetable of a service of the calendar has its name.
+    const auto& section = cfg.at(sname);
+    if (section.count("services")) {
+        for (const auto& servicestr: section.at("services").items()) {
+            auto&   schedule = route.serviceSchedule(calendar.find(servicestr));
+            schedule.setStopCount(stoplist.size());
+            read(cfg, sname + "." + servicestr, route.stops(), dtimeLines, schedule);
+        }
+    }
 }
 
 //  read [<line>.<route>.durations]
@@ -181,4 +253,58 @@ void read(const Utility::IniDoc::Doc& cfg, WalkingTimes& wt) {
     }
 }
 
+void read(const Utility::IniDoc::Doc& cfg, StopCoordinates& sc) {
+    //  [coordinates] "stop=latitude,longitude", apart from the descriptions in [stops].
+    const auto csectionIt = cfg.find("coordinates");
+    if (csectionIt == cfg.cend()) {
+        return;
+    }
+    for (const auto& cline: csectionIt->second) {
+        Coordinates position;
+        if (!parseCoordinates(cline.second.string(), position)) {
+            throw std::runtime_error(std::string{"invalid coordinates of stop "}.append(cline.first));
+        }
+        sc.emplace(cline.first, position);
+    }
+}
 
+void read(const Utility::IniDoc::Doc& cfg, ServiceCalendar& calendar) {
+    //  "name=first,last,weekdays", the weekdays from sunday as in "0111110", and the dates
+    //  of [calendar.<name>] "date=added|removed".
+    const auto csectionIt = cfg.find("calendar");
+    if (csectionIt == cfg.cend()) {
+        return;
+    }
+    auto    to_date = [](const std::string& str) {
+        Date    date;
+        if (!parseDate(str, date)) {
+            throw std::runtime_error(std::string{"invalid date "}.append(str));
+        }
+        return date;
+    };
+    for (const auto& cline: csectionIt->second) {
+        const auto& items = cline.second.items();
+        if (items.size() != 3 || items[2].size() != 7 || items[2].find_first_not_of("01") != std::string::npos) {
+            throw std::runtime_error(std::string{"invalid calendar entry "}.append(cline.first));
+        }
+        ServiceCalendar::Service    service{cline.first, to_date(items[0]), to_date(items[1]), 0, {}, {}};
+        for (size_t d = 0; d < 7; ++d) {
+            service.weekdays |= static_cast<std::uint8_t>((items[2][d] == '1') << d);
+        }
+        const auto  esectionIt = cfg.find("calendar." + cline.first);
+        if (esectionIt != cfg.cend()) {
+            for (const auto& eline: esectionIt->second) {
+                const auto& change = eline.second.string();
+                if (change == "added") {
+                    service.added.push_back(to_date(eline.first));
+                } else if (change == "removed") {
+                    service.removed.push_back(to_date(eline.first));
+                } else {
+                    throw std::runtime_error(std::string{"invalid calendar exception "}.append(eline.first));
+                }
+            }
+        }
+        calendar.add(std::move(service));
+    }
+    calendar.compile();
+}
@@ -2,9 +2,18 @@
 #ifndef CONFIG_HPP
 #define CONFIG_HPP
 
+#include <string>
+
 #include "../utility/ini_doc.hpp"
 #include "lines.hpp"
 
+void getConfig(Utility::IniDoc& config, const std::string& fname);
+//  Merge the files listed in the "imports" property, relative to 'dir' when given.
+void resolveImports(Utility::IniDoc& config, const std::string& dir = std::string{});
 void read(const Utility::IniDoc::Doc& cfg, Lines& lines, StopDescriptions &sds);
+//  The [groups] section, "name=stop,stop...", if there is one.
+void read(const Utility::IniDoc::Doc& cfg, StopGroups& groups);
+//  The "walking-speed" property, in km/h, or defaultWalkingSpeed.
+double walkingSpeed(const Utility::IniDoc::Doc& cfg);
 
 #endif // CONFIG_HPP
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "connection_scan.hpp"
+
+const size_t          ConnectionScan::laneCount;
+const std::uint32_t   ConnectionScan::toTarget;
+
+ConnectionScan::ConnectionScan(const Lines& lines, Day day): table_{lines, day, false}, connections_{} {
+    for (TripIndex trip = 0; trip < table_.tripCount(); ++trip) {
+        auto        patternIx = table_.tripPattern(trip);
+        const auto& pattern = table_.pattern(patternIx);
+        for (std::uint32_t pos = 0; pos + 1 < pattern.stopCount; ++pos) {
+            connections_.push_back(Connection{
+                trip, pos, table_.patternStop(patternIx, pos), table_.patternStop(patternIx, pos + 1),
+                table_.time(trip, pos), table_.time(trip, pos + 1)});
+        }
+    }
+    //  a trip may stay at a stop, so its later connections go first among those leaving at the
+    //  same time.
+    std::sort(connections_.begin(), connections_.end(), [](const Connection& ca, const Connection& cb) {
+        return
+            ca.departure > cb.departure ||
+            (ca.departure == cb.departure && (ca.trip < cb.trip || (ca.trip == cb.trip && ca.position > cb.position)));
+    });
+}
+
+void ConnectionScan::Labels::resize(size_t stopCount, size_t tripCount) {
+    need.resize(stopCount);
+    needFrom.resize(stopCount);
+    latest.resize(stopCount);
+    reach.resize(tripCount);
+}
+
+void ConnectionScan::planFromArrive(
+    const Stop& from, const Stop& to, const std::vector<Time>& arrives, std::vector<Journey>& journeys,
+    QueryStats* stats) const {
+
+    journeys.clear();
+    if (arrives.empty()) {
+        return;
+    }
+    StopIndex   origin, target;
+    if (!table_.findStop(to, target)) {
+        throw std::out_of_range(std::string{"Unknown stop "}.append(to));
+    }
+    if (!table_.findStop(from, origin)) {
+        throw std::out_of_range(std::string{"Unknown stop "}.append(from));
+    }
+    journeys.assign(arrives.size(), Journey{});
+    if (origin == target) {
+        return;
+    }
+
+    static thread_local Labels  labels;
+    labels.resize(table_.stopCount(), table_.tripCount());
+    for (size_t first = 0; first < arrives.size(); first += laneCount) {
+        auto    count = std::min(laneCount, arrives.size() - first);
+
+        ScopedTimer searchTimer{stats, Phase::search};
+        scan(origin, target, arrives.data() + first, count, labels, stats);
+        searchTimer.stop();
+
+        ScopedTimer reconstructionTimer{stats, Phase::reconstruction};
+        for (size_t lane = 0; lane < count; ++lane) {
+            if (labels.best[lane] != minusInf) {
+                makeJourney(labels, lane, origin, target, arrives[first + lane], journeys[first + lane]);
+            }
+        }
+    }
+}
+
+void ConnectionScan::scan(
+    StopIndex origin, StopIndex target, const Time* arrives, size_t count, Labels& labels,
+    QueryStats* stats) const {
+
+    Lanes   none;
+    none.fill(minusInf);
+    std::fill(labels.need.begin(), labels.need.end(), none);
+    std::fill(labels.reach.begin(), labels.reach.end(), 0);
+    std::fill(labels.latest.begin(), labels.latest.end(), minusInf);
+    //  unused lanes are never live
+    labels.best.fill(Time{std::chrono::hours{48}});
+    std::fill(labels.best.begin(), labels.best.begin() + count, minusInf);
+    labels.bestFrom.fill(toTarget);
+
+    //  Unused lanes stay at minusInf, which no connection reaches.
+    auto&   targetNeed = labels.need[target];
+    std::copy(arrives, arrives + count, targetNeed.begin());
+    labels.needFrom[target].fill(toTarget);
+    labels.latest[target] = *std::max_element(arrives, arrives + count);
+    for (const auto& footpath: table_.footpaths(target)) {
+        for (size_t lane = 0; lane < count; ++lane) {
+            labels.need[footpath.stop][lane] = std::max(labels.need[footpath.stop][lane], targetNeed[lane] - footpath.duration);
+        }
+        labels.needFrom[footpath.stop].fill(toTarget);
+        labels.latest[footpath.stop] = labels.latest[target] - footpath.duration;
+    }
+    auto    walk = table_.walkingTime(origin, target);
+    if (walk >= DifTime{0}) {
+        for (size_t lane = 0; lane < count; ++lane) {
+            labels.best[lane] = targetNeed[lane] - walk;
+        }
+    }
+
+    //  Set the lanes in 'mask' of 'need' to 'time' where it is later, from connection 'c'.
+    auto    relax = [&labels](StopIndex stopIx, Time time, LaneMask mask, std::uint32_t c) {
+        auto&   need = labels.need[stopIx];
+        auto&   needFrom = labels.needFrom[stopIx];
+        for (size_t lane = 0; lane < laneCount; ++lane) {
+            bool    later = ((mask >> lane) & 1) && time > need[lane];
+            need[lane] = later ? time : need[lane];
+            needFrom[lane] = later ? c : needFrom[lane];
+        }
+        labels.latest[stopIx] = std::max(labels.latest[stopIx], time);
+    };
+    auto    depart = [&labels](Time time, LaneMask mask, std::uint32_t c) {
+        for (size_t lane = 0; lane < laneCount; ++lane) {
+            if (((mask >> lane) & 1) && time > labels.best[lane]) {
+                labels.best[lane] = time;
+                labels.bestFrom[lane] = c;
+            }
+        }
+    };
+
+    auto    latest = *std::max_element(arrives, arrives + count);
+    auto    first = std::lower_bound(connections_.cbegin(), connections_.cend(), latest, [](
+        const Connection& connection, Time time) {
+
+        return connection.departure > time;
+    });
+    for (auto it = first; it != connections_.cend(); ++it) {
+        const auto& connection = *it;
+        //  A lane is done once it departs from the origin later than the connections left.
+        LaneMask    live = 0;
+        for (size_t lane = 0; lane < laneCount; ++lane) {
+            live |= static_cast<LaneMask>(connection.departure >= labels.best[lane]) << lane;
+        }
+        if (!live) {
+            break;
+        }
+        if (stats) {
+            stats->count(Counter::verticesSettled);
+        }
+
+        //  most connections reach nothing in time: the latest lane of a stop tells without
+        //  looking at its lanes.
+        auto&       reach = labels.reach[connection.trip];
+        LaneMask    alight = 0;
+        if (connection.arrival <= labels.latest[connection.to]) {
+            const auto& need = labels.need[connection.to];
+            for (size_t lane = 0; lane < laneCount; ++lane) {
+                alight |= static_cast<LaneMask>(connection.arrival <= need[lane]) << lane;
+            }
+        }
+        reach |= alight;
+        auto    mask = reach & live;
+        if (!mask) {
+            continue;
+        }
+        if (stats) {
+            stats->count(Counter::edgesRelaxed);
+        }
+
+        //  getting on takes transferTime, except at the origin.
+        auto    c = static_cast<std::uint32_t>(it - connections_.cbegin());
+        auto    board = connection.departure - transferTime;
+        relax(connection.from, board, mask, c);
+        if (connection.from == origin) {
+            depart(connection.departure, mask, c);
+        }
+        for (const auto& footpath: table_.footpaths(connection.from)) {
+            relax(footpath.stop, board - footpath.duration, mask, c);
+            if (footpath.stop == origin) {
+                depart(board - footpath.duration, mask, c);
+            }
+        }
+    }
+}
+
+void ConnectionScan::makeJourney(
+    const Labels& labels, size_t lane, StopIndex origin, StopIndex target, Time arrive, Journey& journey) const {
+
+    auto    add_walk = [this, &journey](StopIndex from, Time leave, StopIndex to) {
+        journey.push_back(JourneyLeg{
+            walkingRouteId, {{table_.stop(from), leave}, {table_.stop(to), leave + table_.walkingTime(from, to)}}});
+    };
+
+    TripCounts  trips;
+    journey.clear();
+    auto    c = labels.bestFrom[lane];
+    if (c == toTarget) {
+        add_walk(origin, arrive - table_.walkingTime(origin, target), target);
+        return;
+    }
+    if (connections_[c].from != origin) {
+        const auto& connection = connections_[c];
+        add_walk(
+            origin, connection.departure - transferTime - table_.walkingTime(origin, connection.from),
+            connection.from);
+    }
+    while (true) {
+        const auto& connection = connections_[c];
+        auto        patternIx = table_.tripPattern(connection.trip);
+        unsigned    count = 0;
+        auto        exit = exitOf(labels, lane, connection, trips, count);
+        JourneyLeg  leg{table_.pattern(patternIx).routeid, {}};
+        for (auto pos = connection.position; pos <= exit; ++pos) {
+            leg.stops.emplace_back(table_.stop(table_.patternStop(patternIx, pos)), table_.time(connection.trip, pos));
+        }
+        journey.push_back(std::move(leg));
+
+        auto    alightIx = table_.patternStop(patternIx, exit);
+        auto    alightTime = table_.time(connection.trip, exit);
+        if (alightIx == target) {
+            break;
+        }
+        c = labels.needFrom[alightIx][lane];
+        if (c == toTarget) {
+            add_walk(alightIx, alightTime, target);
+            break;
+        }
+        if (connections_[c].from != alightIx) {
+            add_walk(alightIx, alightTime, connections_[c].from);
+        }
+    }
+}
+
+std::uint32_t ConnectionScan::exitOf(
+    const Labels& labels, size_t lane, const Connection& connection, TripCounts& trips, unsigned& count) const {
+
+    auto            patternIx = table_.tripPattern(connection.trip);
+    std::uint32_t   rv = 0;
+    for (auto pos = connection.position + 1; pos < table_.pattern(patternIx).stopCount; ++pos) {
+        auto    stopIx = table_.patternStop(patternIx, pos);
+        if (table_.time(connection.trip, pos) > labels.need[stopIx][lane]) {
+            continue;
+        }
+        auto    tripsThere = tripsFrom(labels, lane, stopIx, trips);
+        if (rv == 0 || tripsThere < count) {
+            rv = pos;
+            count = tripsThere;
+        }
+    }
+    return rv;
+}
+
+unsigned ConnectionScan::tripsFrom(const Labels& labels, size_t lane, StopIndex stopIx, TripCounts& trips) const {
+    auto    c = labels.needFrom[stopIx][lane];
+    if (c == toTarget) {
+        return 0;
+    }
+    auto    it = trips.find(stopIx);
+    if (it != trips.end()) {
+        return it->second;
+    }
+    unsigned    count = 0;
+    exitOf(labels, lane, connections_[c], trips, count);
+    return trips[stopIx] = count + 1;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef CONNECTION_SCAN_HPP
+#define CONNECTION_SCAN_HPP
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "day.hpp"
+#include "journey.hpp"
+#include "lines.hpp"
+#include "stats.hpp"
+#include "trip_table.hpp"
+
+//  Connection scan (Dibbelt et al., 2013) over a block of arrival times at once, for the
+//  timetable of one day.
+//
+//  The connections (a trip going from a stop to the next) are scanned once by decreasing
+//  departure time. Every stop carries one lane per arrival time: the latest time to be there
+//  to still reach the destination by it. Lanes are fixed size arrays relaxed together, so the
+//  compiler can use vector instructions, and the lanes in which a trip reaches the destination
+//  are the bits of a mask. One scan answers laneCount latest departure queries between the
+//  same stops.
+class ConnectionScan {
+public:
+    static const size_t laneCount = 16;
+
+    ConnectionScan(const Lines& lines, Day day);
+
+    size_t connectionCount() const {
+        return connections_.size();
+    }
+    //  Bytes used by the connections and the table.
+    size_t memoryUsage() const {
+        return table_.memoryUsage() + connections_.capacity() * sizeof(Connection);
+    }
+
+    //  Latest departures from 'from' reaching 'to' by each of 'arrives', one scan per block of
+    //  laneCount of them. 'journeys' receives a journey per arrival time, empty where there is
+    //  none.
+    void planFromArrive(
+        const Stop& from, const Stop& to, const std::vector<Time>& arrives, std::vector<Journey>& journeys,
+        QueryStats* stats = nullptr) const;
+
+private:
+    using Lanes = std::array<Time, laneCount>;
+    using LaneMask = std::uint32_t;
+
+    static const std::uint32_t  toTarget = static_cast<std::uint32_t>(-1);
+
+    struct Connection {
+        TripIndex       trip;
+        std::uint32_t   position;
+        StopIndex       from;
+        StopIndex       to;
+        Time            departure;
+        Time            arrival;
+    };
+    //  Scratch space of a scan, kept by each thread from one query to the next.
+    struct Labels {
+        void resize(size_t stopCount, size_t tripCount);
+
+        std::vector<Lanes>                                      need;       //  per stop
+        std::vector<std::array<std::uint32_t, laneCount>>       needFrom;   //  connection or toTarget
+        std::vector<Time>                                       latest;     //  per stop, of its lanes
+        std::vector<LaneMask>                                   reach;      //  per trip
+        Lanes                                                   best;       //  departure from the origin
+        std::array<std::uint32_t, laneCount>                    bestFrom;
+    };
+
+    void scan(
+        StopIndex origin, StopIndex target, const Time* arrives, size_t count, Labels& labels,
+        QueryStats* stats) const;
+    void makeJourney(
+        const Labels& labels, size_t lane, StopIndex origin, StopIndex target, Time arrive, Journey& journey) const;
+    //  Trips from a stop to the destination on the journey of a lane, by stop.
+    using TripCounts = std::unordered_map<StopIndex, unsigned>;
+    //  Where to get off the trip boarded by 'connection', with the labels of the scan: the stop
+    //  reached in time with the fewest trips left to the destination, into 'count', the first one
+    //  among them. Riding on past the destination to come back to it takes more.
+    std::uint32_t exitOf(
+        const Labels& labels, size_t lane, const Connection& connection, TripCounts& trips, unsigned& count) const;
+    unsigned tripsFrom(const Labels& labels, size_t lane, StopIndex stopIx, TripCounts& trips) const;
+
+    TripTable               table_;
+    std::vector<Connection> connections_;       //  by decreasing departure
+};
+
+#endif // CONNECTION_SCAN_HPP
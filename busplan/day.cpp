@@ -1,6 +1,8 @@
 #include <chrono>
+#include <cstdio>
 #include <ctime>
 #include <map>
+#include <sstream>
 // #include <regex>
 
 #include "day.hpp"
@@ -13,14 +15,63 @@ namespace {
 
 //    const std::regex    iso_date{"[0-9]{1,2}"};
 //    const std::regex    inv_date{R"((\d?\d\.\d?\d(\.(\d\d)?\d\d)))"};
+
+    //  Days from 1970-01-01 to the given day of the proleptic Gregorian calendar.
+    Date fromCivil(int year, unsigned month, unsigned day) {
+        year -= month <= 2;
+        auto    era = (year >= 0 ? year : year - 399) / 400;
+        auto    yoe = static_cast<unsigned>(year - era * 400);
+        auto    doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        auto    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<Date>(doe) - 719468;
+    }
+
 }
 
-Day::Day(const std::string &str) {
+bool parseDate(const std::string& str, Date& date) {
+    int         year;
+    unsigned    month, day;
+    char        dash1, dash2;
+    std::istringstream  iss{str};
+    if (!(iss >> year >> dash1 >> month >> dash2 >> day) || dash1 != '-' || dash2 != '-' || iss.peek() != EOF) {
+        return false;
+    }
+    static const unsigned   monthDays[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (month < 1 || month > 12 || day < 1 || day > monthDays[month - 1]) {
+        return false;
+    }
+    date = fromCivil(year, month, day);
+    //  the 29th of February of a year that has none is the 1st of March.
+    return month != 2 || day != 29 || fromCivil(year, 3, 1) - date == 1;
+}
+
+std::string toString(Date date) {
+    //  the inverse of fromCivil()
+    auto    z = date + 719468;
+    auto    era = (z >= 0 ? z : z - 146096) / 146097;
+    auto    doe = static_cast<unsigned>(z - era * 146097);
+    auto    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    auto    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    auto    mp = (5 * doy + 2) / 153;
+    auto    day = doy - (153 * mp + 2) / 5 + 1;
+    auto    month = mp < 10 ? mp + 3 : mp - 9;
+    auto    year = static_cast<int>(yoe) + era * 400 + (month <= 2);
+    char    buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02u-%02u", year, month, day);
+    return buffer;
+}
+
+Day::Day(const std::string &str): day_{0}, date_{noDate} {
     auto    itd = knownDays.find(str);
     if (itd != knownDays.cend()) {
         day_ = itd->second;
         return ;
     }
+    Date    date;
+    if (parseDate(str, date)) {
+        *this = fromDate(date);
+        return ;
+    }
 
     auto    useday = std::chrono::system_clock::now();
     if (str == "tomorrow" || str == "Tomorrow") {
@@ -28,5 +79,6 @@ Day::Day(const std::string &str) {
     }
 
     auto    t = std::chrono::system_clock::to_time_t(useday);
-    day_ = localtime(&t)->tm_wday;
+    auto    tm = localtime(&t);
+    *this = fromDate(fromCivil(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday));
 }
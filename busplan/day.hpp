@@ -3,25 +3,49 @@
 #define DAY_HPP
 
 #include <cassert>
+#include <cstdint>
 #include <istream>
+#include <limits>
 #include <ostream>
 #include <string>
 
+//  Days since 1970-01-01.
+using Date = std::int32_t;
+constexpr Date  noDate = std::numeric_limits<Date>::min();
+
+//  Parse "yyyy-mm-dd". Returns false if 'str' is not a valid date.
+bool parseDate(const std::string& str, Date& date);
+std::string toString(Date date);
+
+//  Day of the week, and the calendar date when it is known: a weekday name is any such day,
+//  "today", "tomorrow" and "yyyy-mm-dd" are a date.
 class Day {
 public:
-    Day(size_t d = 0): day_{d % 7} {
-        assert(d < 7);
+    constexpr Day(size_t d = 0): day_{(assert(d < 7), d % 7)}, date_{noDate} {
     }
     Day(const std::string& str);
-    operator size_t() const {
+    //  The day of 'date', with it.
+    static Day fromDate(Date date) {
+        Day rv{static_cast<size_t>(((date + 4) % 7 + 7) % 7)};
+        rv.date_ = date;
+        return rv;
+    }
+    constexpr operator size_t() const {
         return day_;
     }
+    constexpr bool hasDate() const {
+        return date_ != noDate;
+    }
+    Date date() const {
+        return date_;
+    }
 
     Day(const Day&) = default;
     Day& operator= (const Day&) = default;
 
 private:
     size_t  day_;
+    Date    date_;
 };
 
 inline std::istream& operator>>(std::istream& is, Day& d) {
@@ -35,12 +59,18 @@ inline std::ostream& operator<<(std::ostream& os, Day d) {
     return os << size_t{d};
 }
 
-const Day                   sunday{0};
-const Day                   monday{1};
-const Day                   tuesday{2};
-const Day                   wednesday{3};
-const Day                   thursday{4};
-const Day                   friday{5};
-const Day                   saturday{6};
-const std::array<Day, 7>    week{sunday, monday, tuesday, wednesday, thursday, friday, saturday};
+constexpr Day   sunday{size_t{0}};
+constexpr Day   monday{size_t{1}};
+constexpr Day   tuesday{size_t{2}};
+constexpr Day   wednesday{size_t{3}};
+constexpr Day   thursday{size_t{4}};
+constexpr Day   friday{size_t{5}};
+constexpr Day   saturday{size_t{6}};
+constexpr Day   week[7]{sunday, monday, tuesday, wednesday, thursday, friday, saturday};
+
+//  Whether week[d] and the days after it are their day of the week, without a date.
+constexpr bool isWeek(size_t d = 0) {
+    return d == 7 || (size_t{week[d]} == d && !week[d].hasDate() && isWeek(d + 1));
+}
+static_assert(isWeek(), "week[d] is day d, without a date");
 #endif // DATE_HPP
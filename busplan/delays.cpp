@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "delays.hpp"
+
+void DelaySnapshot::applyTo(const RouteId& routeid, const Stop& stop, TimeLine& stopTimes) const {
+    auto    shifts = find(routeid, stop);
+    if (shifts == nullptr) {
+        return;
+    }
+    auto    shiftIt = shifts->cbegin();
+    auto    out = stopTimes.begin();
+    for (auto time: stopTimes) {
+        shiftIt = std::lower_bound(shiftIt, shifts->cend(), time, [](const TimeShift& shift, Time t) {
+            return shift.planned < t;
+        });
+        if (shiftIt != shifts->cend() && shiftIt->planned == time) {
+            if (shiftIt->cancelled) {
+                continue;
+            }
+            time = shiftIt->actual;
+        }
+        *out++ = time;
+    }
+    stopTimes.erase(out, stopTimes.end());
+    std::sort(stopTimes.begin(), stopTimes.end());
+}
+
+Time DelaySnapshot::toActual(const RouteId& routeid, const Stop& stop, Time planned) const {
+    auto    shifts = find(routeid, stop);
+    if (shifts == nullptr) {
+        return planned;
+    }
+    auto    shiftIt = std::lower_bound(shifts->cbegin(), shifts->cend(), planned, [](const TimeShift& shift, Time t) {
+        return shift.planned < t;
+    });
+    if (shiftIt == shifts->cend() || shiftIt->planned != planned) {
+        return planned;
+    }
+    return shiftIt->actual;
+}
+
+Time DelaySnapshot::toPlanned(const RouteId& routeid, const Stop& stop, Time actual) const {
+    auto    shifts = find(routeid, stop);
+    if (shifts == nullptr) {
+        return actual;
+    }
+    auto    shiftIt = std::find_if(shifts->cbegin(), shifts->cend(), [actual](const TimeShift& shift) {
+        return !shift.cancelled && shift.actual == actual;
+    });
+    if (shiftIt == shifts->cend()) {
+        return actual;
+    }
+    return shiftIt->planned;
+}
+
+const TimeShifts* DelaySnapshot::find(const RouteId& routeid, const Stop& stop) const {
+    DelayKey    key{routeid, stop};
+    auto        it = changes_.find(key);
+    if (it == changes_.cend()) {
+        it = base_->find(key);
+        if (it == base_->cend()) {
+            return nullptr;
+        }
+    }
+    return it->second.get();
+}
+
+namespace {
+
+//  The snapshot a thread read last from an overlay.
+struct ThreadSnapshot {
+    unsigned long                           overlay;
+    unsigned long                           version;
+    std::shared_ptr<const DelaySnapshot>    snapshot;
+};
+//  Overlays a thread keeps a snapshot of at once.
+const size_t                threadSnapshots = 8;
+std::atomic<unsigned long>  overlays{0};
+
+}
+
+DelayOverlay::DelayOverlay():
+    id_{++overlays}, published_{0}, current_{}, currentMutex_{}, mutex_{}, serviceDay_{}, version_{0}, pending_{},
+    changed_{} {
+
+    publish(std::make_shared<const DelaySnapshot>(
+        serviceDay_, version_, std::make_shared<const DelaySnapshot::Shifts>(), DelaySnapshot::Shifts{}));
+}
+
+std::shared_ptr<const DelaySnapshot> DelayOverlay::snapshot() const {
+    static thread_local ThreadSnapshot  snapshots[threadSnapshots];
+
+    auto&   kept = snapshots[id_ % threadSnapshots];
+    if (kept.overlay != id_ || kept.version != published_.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock{currentMutex_};
+        kept = ThreadSnapshot{id_, published_.load(std::memory_order_relaxed), current_};
+    }
+    return kept.snapshot;
+}
+
+void DelayOverlay::beginServiceDay(Day day) {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    pending_.clear();
+    changed_.clear();
+    serviceDay_ = day;
+    publish(std::make_shared<const DelaySnapshot>(
+        serviceDay_, ++version_, std::make_shared<const DelaySnapshot::Shifts>(), DelaySnapshot::Shifts{}));
+}
+
+bool DelayOverlay::apply(const Lines& lines, const DelayMessage& message) {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    auto    trip = lines.getTripTimes(serviceDay_, message.routeid, message.start);
+    auto    tripIt = std::find_if(trip.cbegin(), trip.cend(), [&message](const TripStopTimes::value_type& stopt) {
+        return stopt.first == message.stop;
+    });
+    if (tripIt == trip.cend()) {
+        return false;
+    }
+    std::for_each(tripIt, trip.cend(), [this, &message](const TripStopTimes::value_type& stopt) {
+        auto                        planned = stopt.second;
+        DelaySnapshot::DelayKey     key{message.routeid, stopt.first};
+        pending_[key][planned] = TimeShift{planned, planned + message.delay, message.cancelled};
+        changed_.insert(key);
+    });
+    return true;
+}
+
+void DelayOverlay::publish() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (changed_.empty()) {
+        return;
+    }
+
+    //  only the shifts of the keys changed are built again, the other ones are shared.
+    //  current_ is only replaced by writers.
+    auto    current = current_;
+    auto    base = current->base();
+    auto    changes = current->changes();
+    for (const auto& key: changed_) {
+        const auto& pending = pending_.at(key);
+        auto        tshifts = std::make_shared<TimeShifts>();
+        tshifts->reserve(pending.size());
+        for (const auto& shiftp: pending) {
+            tshifts->push_back(shiftp.second);
+        }
+        changes[key] = std::move(tshifts);
+    }
+    changed_.clear();
+    if (changes.size() * changes.size() > base->size()) {
+        auto    merged = std::make_shared<DelaySnapshot::Shifts>(*base);
+        for (auto& change: changes) {
+            (*merged)[change.first] = std::move(change.second);
+        }
+        base = std::move(merged);
+        changes.clear();
+    }
+    publish(std::make_shared<const DelaySnapshot>(serviceDay_, ++version_, std::move(base), std::move(changes)));
+}
+
+namespace {
+
+bool parseDelayMessage(const std::string& line, DelayMessage& message) {
+    std::istringstream  iss{line};
+    std::string         startstr, delaystr;
+    if (!(iss >> message.routeid.linen >> message.routeid.routen >> startstr >> message.stop >> delaystr)) {
+        return false;
+    }
+    message.start = toTime(startstr);
+    message.cancelled = delaystr == "cancel";
+    message.delay = DifTime{message.cancelled ? 0 : std::stoi(delaystr)};
+    return true;
+}
+
+}
+
+size_t readDelays(std::istream& is, const Lines& lines, DelayOverlay& overlay) {
+    size_t  applied = 0;
+    for (std::string line; std::getline(is, line);) {
+        auto    first = line.find_first_not_of(" \t");
+        if (first == line.npos || line[first] == ';') {
+            continue;
+        }
+        if (line.compare(first, 4, "day ") == 0) {
+            overlay.publish();
+            overlay.beginServiceDay(Day{line.substr(line.find_first_not_of(" \t", first + 4))});
+            continue;
+        }
+
+        DelayMessage    message;
+        try {
+            if (!parseDelayMessage(line, message)) {
+                throw std::invalid_argument{"missing fields"};
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid delay message: " << line << std::endl;
+            continue;
+        }
+        if (overlay.apply(lines, message)) {
+            ++applied;
+        } else {
+            std::cerr << "Unknown trip in delay message: " << line << std::endl;
+        }
+        if (is.rdbuf()->in_avail() <= 0) {
+            overlay.publish();
+        }
+    }
+    overlay.publish();
+    return applied;
+}
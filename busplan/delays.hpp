@@ -0,0 +1,135 @@
+#pragma once
+#ifndef DELAYS_HPP
+#define DELAYS_HPP
+
+#include <atomic>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "day.hpp"
+#include "lines.hpp"
+#include "stop.hpp"
+#include "time.hpp"
+#include "time_line.hpp"
+
+//  A real-time message: the trip of 'routeid' leaving its first stop at 'start' is delayed by
+//  'delay' (or cancelled) from 'stop' onwards.
+struct DelayMessage {
+    RouteId routeid;
+    Time    start;
+    Stop    stop;
+    DifTime delay;
+    bool    cancelled;
+};
+
+struct TimeShift {
+    Time    planned;
+    Time    actual;
+    bool    cancelled;
+};
+using TimeShifts = std::vector<TimeShift>;
+
+//  Immutable set of delays of one service day, as seen by the search. Shifts are kept per
+//  (route, stop) and sorted by planned time. Snapshots share them: a snapshot is a base of
+//  shifts shared with the ones published before it, and the shifts changed since then.
+class DelaySnapshot {
+public:
+    using DelayKey = std::pair<RouteId, Stop>;
+    using Shifts = std::map<DelayKey, std::shared_ptr<const TimeShifts>>;
+
+    DelaySnapshot(Day day, unsigned long version, std::shared_ptr<const Shifts> base, Shifts changes):
+        day_{day}, version_{version}, base_{std::move(base)}, changes_{std::move(changes)} {
+    }
+
+    Day day() const {
+        return day_;
+    }
+    unsigned long version() const {
+        return version_;
+    }
+    bool empty() const {
+        return base_->empty() && changes_.empty();
+    }
+    //  The delays of a date only apply on it, those of a day of the week on any such day.
+    bool appliesTo(Day day) const {
+        if (empty()) {
+            return false;
+        }
+        return day_.hasDate() ? day.date() == day_.date() : size_t{day} == size_t{day_};
+    }
+    const std::shared_ptr<const Shifts>& base() const {
+        return base_;
+    }
+    const Shifts& changes() const {
+        return changes_;
+    }
+
+    //  Replace planned times of 'stopTimes' by actual ones, dropping cancelled trips.
+    void applyTo(const RouteId& routeid, const Stop& stop, TimeLine& stopTimes) const;
+    Time toActual(const RouteId& routeid, const Stop& stop, Time planned) const;
+    Time toPlanned(const RouteId& routeid, const Stop& stop, Time actual) const;
+
+private:
+    const TimeShifts* find(const RouteId& routeid, const Stop& stop) const;
+
+    Day                             day_;
+    unsigned long                   version_;
+    std::shared_ptr<const Shifts>   base_;
+    Shifts                          changes_;
+};
+
+//  Collects delay messages and publishes them as snapshots. Writers are serialized. Every thread
+//  keeps the last snapshot it read, and reads it again only once the version published changed:
+//  readers take no lock but once per thread and publish(). A snapshot is freed once it is
+//  neither current nor held or kept by any reader.
+class DelayOverlay {
+public:
+    DelayOverlay();
+    DelayOverlay(const DelayOverlay&) = delete;
+    DelayOverlay& operator=(const DelayOverlay&) = delete;
+
+    std::shared_ptr<const DelaySnapshot> snapshot() const;
+
+    //  Drop every delay and start collecting messages for 'day'.
+    void beginServiceDay(Day day);
+    //  Record a message. Returns false if the trip or the stop are unknown. The message is
+    //  visible to readers after the next publish().
+    bool apply(const Lines& lines, const DelayMessage& message);
+    //  Publish the shifts changed since the last publish(). They are merged into the base of
+    //  the snapshot once there are more of them than the square root of its size, so that a
+    //  publish costs about that many shifts, not every shift of the day.
+    void publish();
+
+private:
+    using PendingShifts = std::map<DelaySnapshot::DelayKey, std::map<Time, TimeShift>>;
+
+    void publish(std::shared_ptr<const DelaySnapshot> snapshot) {
+        std::lock_guard<std::mutex> lock{currentMutex_};
+        published_.store(snapshot->version(), std::memory_order_release);
+        current_ = std::move(snapshot);
+    }
+
+    const unsigned long                     id_;        //  of the overlay, in the threads' snapshots
+    std::atomic<unsigned long>              published_; //  version of current_
+    std::shared_ptr<const DelaySnapshot>    current_;
+    mutable std::mutex                      currentMutex_;
+    std::mutex                              mutex_;
+    Day                                     serviceDay_;
+    unsigned long                           version_;
+    PendingShifts                           pending_;
+    std::set<DelaySnapshot::DelayKey>       changed_;   //  since the last publish()
+};
+
+//  Read a delay feed:
+//      day <day>
+//      <line> <route> <start> <stop> <minutes>|cancel
+//  Messages are published when the stream has no more buffered input, so bursts are applied
+//  as a single snapshot. Returns the number of messages applied.
+size_t readDelays(std::istream& is, const Lines& lines, DelayOverlay& overlay);
+
+#endif // DELAYS_HPP
@@ -0,0 +1,58 @@
+#include "direct_connections.hpp"
+
+DirectConnections::DirectConnections(const Lines& lines): routes_{}, stops_{} {
+    lines.forEachRoute([this](const RouteId& routeid, const Route& route) {
+        auto        routeIx = static_cast<std::uint32_t>(routes_.size());
+        const auto& stops = route.stops();
+        routes_.push_back(RouteEntry{routeid, &route});
+        for (size_t i = 0; i < stops.size(); ++i) {
+            stops_[stops[i]].push_back(StopEntry{routeIx, static_cast<std::uint32_t>(i)});
+        }
+    });
+}
+
+bool DirectConnections::latestConnection(
+    Day day, const Stop& from, const Stop& to, Time arrive, JourneyLeg& leg) const {
+
+    auto    fromIt = stops_.find(from);
+    auto    toIt = stops_.find(to);
+    if (fromIt == stops_.cend() || toIt == stops_.cend() || from == to) {
+        return false;
+    }
+
+    //  both lists are sorted by route: walk them together
+    auto    found = false;
+    auto    f = fromIt->second.cbegin();
+    auto    t = toIt->second.cbegin();
+    while (f != fromIt->second.cend() && t != toIt->second.cend()) {
+        if (f->route < t->route) {
+            ++f;
+            continue;
+        }
+        if (t->route < f->route) {
+            ++t;
+            continue;
+        }
+        auto    route = f->route;
+        for (auto fr = f; fr != fromIt->second.cend() && fr->route == route; ++fr) {
+            for (auto tr = t; tr != toIt->second.cend() && tr->route == route; ++tr) {
+                if (fr->position >= tr->position) {
+                    continue;
+                }
+                auto    trip = routes_[route].route->getLatestTrip(day, fr->position, tr->position, arrive);
+                if (!trip.empty() && (!found || trip.front().second > leg.stops.front().second)) {
+                    leg.routeid = routes_[route].routeid;
+                    leg.stops = std::move(trip);
+                    found = true;
+                }
+            }
+        }
+        while (f != fromIt->second.cend() && f->route == route) {
+            ++f;
+        }
+        while (t != toIt->second.cend() && t->route == route) {
+            ++t;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef DIRECT_CONNECTIONS_HPP
+#define DIRECT_CONNECTIONS_HPP
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "day.hpp"
+#include "journey.hpp"
+#include "lines.hpp"
+#include "stop.hpp"
+#include "time.hpp"
+
+//  Routes serving every stop, with the position of the stop in each one, to find the journeys
+//  without change between two stops by lookups: the routes serving both in the right order,
+//  then a binary search of their schedule for the trip.
+class DirectConnections {
+public:
+    //  'lines' must outlive the index.
+    explicit DirectConnections(const Lines& lines);
+    DirectConnections(const DirectConnections&) = delete;
+    DirectConnections& operator=(const DirectConnections&) = delete;
+
+    //  Latest departure from 'from' reaching 'to' by 'arrive' on a single route. Returns false
+    //  if there is none.
+    bool latestConnection(Day day, const Stop& from, const Stop& to, Time arrive, JourneyLeg& leg) const;
+
+private:
+    struct RouteEntry {
+        RouteId         routeid;
+        const Route*    route;
+    };
+    struct StopEntry {
+        std::uint32_t   route;
+        std::uint32_t   position;
+    };
+    using StopEntries = std::vector<StopEntry>;
+
+    std::vector<RouteEntry>     routes_;
+    std::map<Stop, StopEntries> stops_;         //  sorted by route, then position
+};
+
+#endif // DIRECT_CONNECTIONS_HPP
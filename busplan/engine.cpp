@@ -0,0 +1,35 @@
+#include <boost/lexical_cast.hpp>
+
+#include "engine.hpp"
+
+std::istream& operator>>(std::istream& is, Engine& engine) {
+    std::string str;
+    is >> str;
+    if (str == "dijkstra") {
+        engine = Engine::dijkstra;
+    } else if (str == "trip-based") {
+        engine = Engine::tripBased;
+    } else if (str == "transfer-patterns") {
+        engine = Engine::transferPatterns;
+    } else if (str == "connection-scan") {
+        engine = Engine::connectionScan;
+    } else {
+        throw boost::bad_lexical_cast{};
+    }
+
+    return is;
+}
+
+std::ostream& operator<<(std::ostream& os, Engine engine) {
+    switch (engine) {
+    case Engine::dijkstra:
+        return os << "dijkstra";
+    case Engine::tripBased:
+        return os << "trip-based";
+    case Engine::transferPatterns:
+        return os << "transfer-patterns";
+    case Engine::connectionScan:
+        return os << "connection-scan";
+    }
+    throw boost::bad_lexical_cast{};
+}
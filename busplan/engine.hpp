@@ -0,0 +1,20 @@
+#pragma once
+#ifndef ENGINE_HPP
+#define ENGINE_HPP
+
+#include <istream>
+#include <ostream>
+
+//  Search used to plan journeys. Days with delays or calendar services are always planned by
+//  the graph search, the only one to apply them, so the other engines then give its plans.
+enum class Engine {
+    dijkstra,           //  on the stop graph, nothing to precompute
+    tripBased,          //  on trips, with precomputed transfers
+    transferPatterns,   //  along precomputed transfer patterns
+    connectionScan      //  on connections, many arrival times at once
+};
+
+std::istream& operator>>(std::istream&, Engine&);
+std::ostream& operator<<(std::ostream&, Engine);
+
+#endif // ENGINE_HPP
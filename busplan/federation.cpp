@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+
+#include "config.hpp"
+#include "federation.hpp"
+
+Federation::Federation(StopSet borders): borders_{std::move(borders)}, mutex_{}, partitions_{} {
+}
+
+void Federation::load(const std::string& name, const std::string& dir) {
+    Utility::IniDoc config;
+    getConfig(config, dir + "/busplan.cfg");
+    resolveImports(config, dir);
+
+    Lines   lines;
+    auto    partition = std::make_shared<Partition>();
+    partition->dir = dir;
+    read(config.doc(), lines, partition->stopdescs);
+    if (!lines.calendar().empty()) {
+        throw std::runtime_error(std::string{"calendar services in partition "}.append(name));
+    }
+    partition->network.reset(new BusNetwork{std::move(lines)});
+    for (const auto& stop: borders_) {
+        if (partition->network->hasStop(stop)) {
+            partition->borders.push_back(stop);
+        }
+    }
+    //  before the partition is published, so that no query computes them.
+    for (const auto& day: week) {
+        partition->profiles[day] = computeProfiles(*partition, day);
+    }
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    partitions_[name] = partition;
+}
+
+void Federation::reload(const std::string& name) {
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        dir = partitions_.at(name)->dir;
+    }
+    load(name, dir);
+}
+
+std::vector<std::string> Federation::partitionNames() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    std::vector<std::string>    rv;
+    for (const auto& partition: partitions_) {
+        rv.push_back(partition.first);
+    }
+    return rv;
+}
+
+StopDescriptions Federation::stopDescriptions() const {
+    StopDescriptions    rv;
+    for (const auto& partition: snapshot()) {
+        rv.insert(partition->stopdescs.cbegin(), partition->stopdescs.cend());
+    }
+    return rv;
+}
+
+std::vector<Federation::PartitionPtr> Federation::snapshot() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    std::vector<PartitionPtr>   rv;
+    for (const auto& partition: partitions_) {
+        rv.push_back(partition.second);
+    }
+    return rv;
+}
+
+Federation::Profiles Federation::computeProfiles(const Partition& partition, Day day) {
+    Profiles    rv;
+    const auto& borders = partition.borders;
+    //  one search to each border stop by each time a bus arrives there, the plans from the
+    //  other ones read from it: they arrive by then, with the time to change there.
+    const auto& lines = partition.network->lines();
+    for (const auto& to: borders) {
+        Stops   froms;
+        std::copy_if(borders.cbegin(), borders.cend(), std::back_inserter(froms), [&to](const Stop& stop) {
+            return stop != to;
+        });
+        if (froms.empty()) {
+            continue;
+        }
+        std::set<Time>  arrivals;
+        lines.forEachRoute([&lines, &to, day, &arrivals](const RouteId& routeid, const Route& route) {
+            const auto& stops = route.stops();
+            if (std::find(stops.cbegin() + 1, stops.cend(), to) != stops.cend()) {
+                auto    times = lines.getStopTimes(day, routeid, to);
+                arrivals.insert(times.cbegin(), times.cend());
+            }
+        });
+        for (auto arrival: arrivals) {
+            auto    plans = partition.network->planFromArrive(
+                day, froms, to, arrival + transferTime, Details::steps);
+            for (size_t ix = 0; ix < froms.size(); ++ix) {
+                if (!plans[ix].empty()) {
+                    rv[std::make_pair(froms[ix], to)].push_back(ProfileEntry{
+                        plans[ix].front().from.time, plans[ix].back().to.time, arrival + transferTime});
+                }
+            }
+        }
+    }
+    //  only the entries leaving later than every one arriving before them.
+    for (auto& profile: rv) {
+        auto&   entries = profile.second;
+        std::sort(entries.begin(), entries.end(), [](const ProfileEntry& entrya, const ProfileEntry& entryb) {
+            return entrya.arrive < entryb.arrive ||
+                (entrya.arrive == entryb.arrive && entrya.leave > entryb.leave);
+        });
+        Profile kept;
+        for (const auto& entry: entries) {
+            if (kept.empty() || entry.leave > kept.back().leave) {
+                kept.push_back(entry);
+            }
+        }
+    entries.swap(kept);
+    }
+    return rv;
+}
+
+const Federation::ProfileEntry* Federation::latest(const Profile& profile, Time arrive) {
+    auto    it = std::upper_bound(
+        profile.cbegin(), profile.cend(), arrive, [](Time time, const ProfileEntry& entry) {
+
+        return time < entry.arrive;
+    });
+    return it == profile.cbegin() ? nullptr : &*(it - 1);
+}
+
+Federation::NodeList Federation::planFromArrive(
+    Day day, const Stop& from, const Stop& to, Time arrive, Details details, QueryStats* stats) const {
+
+    auto    partitions = snapshot();
+    auto    known = [&partitions](const Stop& stop) {
+        for (const auto& partition: partitions) {
+            if (partition->network->hasStop(stop)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    if (!known(from) || !known(to)) {
+        throw std::out_of_range(std::string{"No partition serves "}.append(known(from) ? to : from));
+    }
+    for (const auto& partition: partitions) {
+        if (partition->network->hasStop(from) && partition->network->hasStop(to)) {
+            return partition->network->planFromArrive(day, from, to, arrive, details, stats);
+        }
+    }
+    auto    serves = [](const Partition& partition, const Stop& stop) {
+        return std::find(partition.borders.cbegin(), partition.borders.cend(), stop) != partition.borders.cend();
+    };
+
+    //  the border stops of the partitions of the destination, with one search from it in each.
+    std::map<Stop, Leg> legs;
+    legs.emplace(to, Leg{arrive, nullptr, to, arrive});
+    auto    improve = [&legs](const Stop& stop, const Leg& leg) {
+        auto    it = legs.find(stop);
+        if (it == legs.end()) {
+            legs.emplace(stop, leg);
+            return;
+        }
+        if (leg.leave > it->second.leave) {
+            it->second = leg;
+        }
+    };
+    for (const auto& partition: partitions) {
+        if (!partition->network->hasStop(to)) {
+            continue;
+        }
+        Stops   froms;
+        std::copy_if(
+            partition->borders.cbegin(), partition->borders.cend(), std::back_inserter(froms),
+            [&to](const Stop& stop) {
+
+            return stop != to;
+        });
+        auto    plans = partition->network->planFromArrive(day, froms, to, arrive, Details::ends, stats);
+        for (size_t ix = 0; ix < froms.size(); ++ix) {
+            if (!plans[ix].empty()) {
+                improve(froms[ix], Leg{plans[ix].front().from.time, partition.get(), to, arrive});
+            }
+        }
+    }
+
+    //  the overlay, latest first: a label is final once settled, and reaches the other border
+    //  stops of its partitions by their profiles, arriving in time to change at it.
+    StopSet settled;
+    while (true) {
+        auto    best = legs.cend();
+        for (auto it = legs.cbegin(); it != legs.cend(); ++it) {
+            if (!settled.count(it->first) && it->second.leave != minusInf &&
+                (best == legs.cend() || it->second.leave > best->second.leave)) {
+
+                best = it;
+            }
+        }
+        if (best == legs.cend()) {
+            break;
+        }
+        auto    stop = best->first;
+        auto    leave = best->second.leave;
+        settled.insert(stop);
+        for (const auto& partition: partitions) {
+            if (!serves(*partition, stop)) {
+                continue;
+            }
+            const auto& partitionProfiles = partition->profiles[day];
+            for (const auto& border: partition->borders) {
+                auto    it = partitionProfiles.find(std::make_pair(border, stop));
+                if (border == stop || border == to || settled.count(border) || it == partitionProfiles.cend()) {
+                    continue;
+                }
+                auto    entry = latest(it->second, leave - transferTime);
+                if (entry) {
+                    improve(border, Leg{entry->leave, partition.get(), stop, entry->by});
+                }
+            }
+        }
+    }
+
+    //  the partitions of the origin, each to the border stop it leaves the latest for. Their own
+    //  search goes between their border stops: a border stop is only a destination to leave them,
+    //  it would otherwise take the time to change from a bus going on through it. That search
+    //  bounds when the last step leaves, so a plan arriving too late to change is searched again
+    //  with the deadline of its border stop moved back by as much.
+    NodeList    rv;
+    Stop        border;
+    Time        best = minusInf;
+    auto        legIt = legs.find(from);
+    if (legIt != legs.cend()) {
+        best = legIt->second.leave;
+        border = from;
+    }
+    for (const auto& partition: partitions) {
+        if (!partition->network->hasStop(from)) {
+            continue;
+        }
+        BusNetwork::Deadlines   deadlines;
+        for (const auto& stop: partition->borders) {
+            auto    it = legs.find(stop);
+            if (stop != from && it != legs.cend() && it->second.partition != partition.get()) {
+                deadlines.emplace_back(stop, it->second.leave);
+            }
+        }
+        auto    plan = partition->network->planFromArrive(day, from, deadlines, details, stats);
+        while (!plan.empty()) {
+            auto    deadline = std::find_if(
+                deadlines.begin(), deadlines.end(), [&plan](const BusNetwork::Deadlines::value_type& deadline) {
+
+                return deadline.first == plan.back().to.stop;
+            });
+            auto    late = plan.back().to.time + transferTime - legs.at(deadline->first).leave;
+            if (late <= DifTime{0}) {
+                break;
+            }
+            deadline->second -= late;
+            plan = partition->network->planFromArrive(day, from, deadlines, details, stats);
+        }
+        if (!plan.empty() && plan.front().from.time > best) {
+            best = plan.front().from.time;
+            border = plan.back().to.stop;
+            rv.swap(plan);
+        }
+    }
+    if (best == minusInf) {
+        return NodeList{};
+    }
+
+    //  then the legs of the overlay, each planned again in its partition. Each one leaves once
+    //  the one before has arrived and the time to change has passed: the plan is one of the
+    //  merged network too, so it never leaves later than the best plan of the merged network.
+    for (auto stop = border; stop != to;) {
+        const auto& leg = legs.at(stop);
+        auto        plan = leg.partition->network->planFromArrive(day, stop, leg.next, leg.arrive, details, stats);
+        if (plan.empty()) {
+            return NodeList{};
+        }
+        assert(rv.empty() || rv.back().to.time + transferTime <= plan.front().from.time);
+        rv.insert(rv.end(), plan.cbegin(), plan.cend());
+        stop = leg.next;
+    }
+    if (details == Details::ends && rv.size() > 1) {
+        rv.front().to = rv.back().to;
+        rv.front().routeid = RouteId{};
+        rv.resize(1);
+    }
+    return rv;
+}
+
+std::unique_ptr<Federation> readFederation(const std::string& fname) {
+    Utility::IniDoc config;
+    getConfig(config, fname);
+    const auto& doc = config.doc();
+    const auto& root = doc.at("");
+    const auto& borders = root.at("border-stops").items();
+    auto        dirPos = fname.find_last_of("/\\");
+    auto        dir = dirPos == std::string::npos ? std::string{} : fname.substr(0, dirPos + 1);
+
+    std::unique_ptr<Federation> rv{new Federation{StopSet(borders.cbegin(), borders.cend())}};
+    for (const auto& name: root.at("partitions").items()) {
+        rv->load(name, dir + doc.at(name).at("network").string());
+    }
+    return rv;
+}
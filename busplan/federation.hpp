@@ -0,0 +1,100 @@
+#pragma once
+#ifndef FEDERATION_HPP
+#define FEDERATION_HPP
+
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bus_network.hpp"
+#include "day.hpp"
+#include "details.hpp"
+#include "lines.hpp"
+#include "stats.hpp"
+#include "stop.hpp"
+#include "time.hpp"
+
+//  Regional networks planned as one: each partition is a network of its own, loaded and
+//  reloaded on its own, and they share the border stops. Between the border stops a partition
+//  serves, profiles tell the latest time to leave one of them to reach another one by each
+//  time. A plan between partitions searches the partitions of the destination from it to their
+//  border stops, then the overlay of the profiles between border stops, then the partitions of
+//  the origin to the border stops; the partitions crossed in between are only asked for the legs
+//  of the plan found.
+class Federation {
+public:
+    using NodeList = BusNetwork::NodeList;
+
+    //  'borders': the stops where the partitions meet.
+    explicit Federation(StopSet borders);
+    Federation(const Federation&) = delete;
+    Federation& operator=(const Federation&) = delete;
+
+    //  Load the partition 'name' from busplan.cfg in 'dir', replacing the one of the same name,
+    //  with its profiles. Queries already running keep the partitions they started with. Throws
+    //  std::runtime_error for a partition with calendar services, since the profiles are by day
+    //  of the week.
+    void load(const std::string& name, const std::string& dir);
+    //  Load the partition 'name' again from its directory. Throws std::out_of_range if there is
+    //  no such partition.
+    void reload(const std::string& name);
+    std::vector<std::string> partitionNames() const;
+    //  The stop descriptions of every partition.
+    StopDescriptions stopDescriptions() const;
+    //  Latest plan from 'from' arriving at 'to' by 'arrive'. Within a partition serving both
+    //  stops, the plan of that partition. Queries may run concurrently, and with load(). Throws
+    //  std::out_of_range for a stop no partition serves.
+    NodeList planFromArrive(
+        Day day, const Stop& from, const Stop& to, Time arrive, Details details, QueryStats* stats = nullptr) const;
+
+private:
+    //  Leaving a border stop at 'leave' for another one, arriving there at 'arrive': a change
+    //  there takes transferTime from it. 'by' is the time it was planned with, to plan it again.
+    struct ProfileEntry {
+        Time    leave;
+        Time    arrive;
+        Time    by;
+    };
+    //  By arrival, every entry leaving later than the ones before it.
+    using Profile = std::vector<ProfileEntry>;
+    //  By border stops, from and to.
+    using Profiles = std::map<std::pair<Stop, Stop>, Profile>;
+    struct Partition {
+        std::string                 dir;
+        std::unique_ptr<BusNetwork> network;
+        StopDescriptions            stopdescs;
+        Stops                       borders;        //  the border stops it serves
+        std::array<Profiles, 7>     profiles;       //  by day of the week
+    };
+    using PartitionPtr = std::shared_ptr<const Partition>;
+    //  Latest time to leave a stop for the destination: the partition taken there, and the next
+    //  stop of the plan with the time the leg was planned with, so that it is planned again as
+    //  the search found it. No partition at the destination itself.
+    struct Leg {
+        Time                leave;
+        const Partition*    partition;
+        Stop                next;
+        Time                arrive;
+    };
+
+    std::vector<PartitionPtr> snapshot() const;
+    static Profiles computeProfiles(const Partition& partition, Day day);
+    //  The entry of 'profile' leaving the latest while arriving by 'arrive', nullptr if there is
+    //  none.
+    static const ProfileEntry* latest(const Profile& profile, Time arrive);
+
+    StopSet                             borders_;
+    mutable std::mutex                  mutex_;
+    std::map<std::string, PartitionPtr> partitions_;
+};
+
+//  The federation of the configuration 'fname': its "partitions" property lists the sections of
+//  the partitions, each with the directory of its busplan.cfg in "network", relative to the one
+//  of 'fname', and "border-stops" lists the stops where they meet.
+std::unique_ptr<Federation> readFederation(const std::string& fname);
+
+#endif // FEDERATION_HPP
@@ -3,23 +3,255 @@
 
 #include "fragment.hpp"
 
+namespace {
+
+    //  'count' values of 'width' bits. No value depends on the previous one, so that the
+    //  compiler can vectorize the loop where the target has vector instructions.
+    void unpack(const std::uint64_t* words, unsigned width, size_t count, std::uint32_t* values) {
+        if (width == 0) {
+            std::fill(values, values + count, 0);
+            return;
+        }
+        const auto  mask = (std::uint64_t{1} << width) - 1;
+        for (size_t k = 0; k < count; ++k) {
+            auto    pos = k * width;
+            auto    shift = pos % 64;
+            auto    value = words[pos / 64] >> shift;
+            if (shift + width > 64) {
+                value |= words[pos / 64 + 1] << (64 - shift);
+            }
+            values[k] = static_cast<std::uint32_t>(value & mask);
+        }
+    }
+
+}
+
+const size_t    Fragment::blockSize;
+
+void Fragment::compress() {
+    if (compressed_) {
+        return;
+    }
+    auto    count = blockCount();
+    blocks_.reserve(stopCount_ * count);
+    for (size_t stopIx = 0; stopIx < stopCount_; ++stopIx) {
+        for (size_t blockIx = 0; blockIx < count; ++blockIx) {
+            auto    first = blockIx * blockSize;
+            auto    last = std::min(first + blockSize, timeLinesCount_);
+            auto    column = [this, stopIx](size_t timelineIx) {
+                return timeTable_[timelineIx * stopCount_ + stopIx];
+            };
+
+            Block           b{column(first), column(first), column(first), 0, 0};
+            std::uint32_t   deltas[blockSize];
+            std::uint32_t   all = 0;
+            for (auto ix = first + 1; ix < last; ++ix) {
+                auto    delta = static_cast<std::int32_t>((column(ix) - column(ix - 1)).count());
+                deltas[ix - first - 1] = (static_cast<std::uint32_t>(delta) << 1) ^ static_cast<std::uint32_t>(delta >> 31);
+                all |= deltas[ix - first - 1];
+                b.low = std::min(b.low, column(ix));
+                b.high = std::max(b.high, column(ix));
+            }
+            while (all >> b.width) {
+                ++b.width;
+            }
+
+            b.offset = static_cast<std::uint32_t>(packed_.size());
+            packed_.resize(packed_.size() + ((last - first - 1) * b.width + 63) / 64, 0);
+            auto    words = packed_.data() + b.offset;
+            for (size_t k = 0; k + 1 < last - first; ++k) {
+                auto    pos = k * b.width;
+                auto    shift = pos % 64;
+                words[pos / 64] |= std::uint64_t{deltas[k]} << shift;
+                if (shift + b.width > 64) {
+                    words[pos / 64 + 1] |= std::uint64_t{deltas[k]} >> (64 - shift);
+                }
+            }
+            blocks_.push_back(b);
+        }
+    }
+    timeTable_.clear();
+    timeTable_.shrink_to_fit();
+    packed_.shrink_to_fit();
+    compressed_ = true;
+}
+
+size_t Fragment::decodeBlock(size_t stopIndex, size_t blockIx, Time* times) const {
+    const auto&     b = block(stopIndex, blockIx);
+    auto            count = std::min(blockSize, timeLinesCount_ - blockIx * blockSize);
+    std::uint32_t   deltas[blockSize];
+    unpack(packed_.data() + b.offset, b.width, count - 1, deltas);
+
+    auto    time = b.first;
+    times[0] = time;
+    for (size_t k = 1; k < count; ++k) {
+        auto    delta = deltas[k - 1];
+        time += DifTime{static_cast<DifTime::rep>(delta >> 1) ^ -static_cast<DifTime::rep>(delta & 1)};
+        times[k] = time;
+    }
+    return count;
+}
+
 TimeLine Fragment::getStopTimes(size_t stopIndex) const {
     if (stopIndex >= stopCount_) {
         throw std::out_of_range{"stop index out of range in schedule"};
     }
 
     TimeLine    rv;
+    if (compressed_) {
+        rv.resize(timeLinesCount_);
+        for (size_t blockIx = 0; blockIx < blockCount(); ++blockIx) {
+            decodeBlock(stopIndex, blockIx, rv.data() + blockIx * blockSize);
+        }
+        return rv;
+    }
     for (size_t i = 0; i < timeLinesCount_; ++i) {
         rv.push_back(timeTable_[i * stopCount_ + stopIndex]);
     }
     return rv;
 }
 
+TimeLine Fragment::getTimes() const {
+    if (!compressed_) {
+        return TimeLine(timeTable_.cbegin(), timeTable_.cend());
+    }
+
+    TimeLine    rv(stopCount_ * timeLinesCount_);
+    Time        times[blockSize];
+    for (size_t stopIx = 0; stopIx < stopCount_; ++stopIx) {
+        for (size_t blockIx = 0; blockIx < blockCount(); ++blockIx) {
+            auto    count = decodeBlock(stopIx, blockIx, times);
+            for (size_t k = 0; k < count; ++k) {
+                rv[(blockIx * blockSize + k) * stopCount_ + stopIx] = times[k];
+            }
+        }
+    }
+    return rv;
+}
+
 std::pair<Time, bool> Fragment::findArriveTime(size_t fromIndex, Time leave, size_t toIndex) const {
-    auto    leaves = getStopTimes(fromIndex);
-    auto    leaveIt = std::find(leaves.cbegin(), leaves.cend(), leave);
-    if (leaveIt == leaves.cend()) {
+    if (compressed_) {
+        //  only the blocks whose range has the time
+        Time    times[blockSize];
+        for (size_t blockIx = 0; blockIx < blockCount(); ++blockIx) {
+            const auto& b = block(fromIndex, blockIx);
+            if (leave < b.low || leave > b.high) {
+                continue;
+            }
+            auto    count = decodeBlock(fromIndex, blockIx, times);
+            auto    it = std::find(times, times + count, leave);
+            if (it != times + count) {
+                return std::make_pair(getTime(blockIx * blockSize + (it - times), toIndex), true);
+            }
+        }
         return std::make_pair(leave, false);
     }
-    return std::make_pair(*(leaveIt + toIndex - fromIndex), true);
+    for (size_t i = 0; i < timeLinesCount_; ++i) {
+        if (timeTable_[i * stopCount_ + fromIndex] == leave) {
+            return std::make_pair(getTime(i, toIndex), true);
+        }
+    }
+    return std::make_pair(leave, false);
+}
+
+std::pair<TimeLine, bool> Fragment::findTimeLine(Time start) const {
+    if (compressed_) {
+        //  only the blocks of the first column whose range has the time
+        Time    times[blockSize];
+        for (size_t blockIx = 0; blockIx < blockCount(); ++blockIx) {
+            const auto& b = block(0, blockIx);
+            if (start < b.low || start > b.high) {
+                continue;
+            }
+            auto    count = decodeBlock(0, blockIx, times);
+            auto    it = std::find(times, times + count, start);
+            if (it != times + count) {
+                auto        i = blockIx * blockSize + (it - times);
+                TimeLine    rv;
+                for (size_t stopIx = 0; stopIx < stopCount_; ++stopIx) {
+                    rv.push_back(getTime(i, stopIx));
+                }
+                return std::make_pair(rv, true);
+            }
+        }
+        return std::make_pair(TimeLine{}, false);
+    }
+    for (size_t i = 0; i < timeLinesCount_; ++i) {
+        if (timeTable_[i * stopCount_] == start) {
+            auto    first = timeTable_.cbegin() + i * stopCount_;
+            return std::make_pair(TimeLine(first, first + stopCount_), true);
+        }
+    }
+    return std::make_pair(TimeLine{}, false);
+}
+
+size_t Fragment::findLatestTimeLine(size_t fromIndex, size_t toIndex, Time arrive) const {
+    assert(fromIndex < stopCount_);
+    assert(toIndex < stopCount_);
+
+    if (overtaking_) {
+        //  every time line by 'arrive', the one leaving the latest.
+        size_t  rv = timeLinesCount_;
+        if (compressed_) {
+            Time    arrives[blockSize];
+            Time    leaves[blockSize];
+            Time    latest{};
+            for (size_t blockIx = 0; blockIx < blockCount(); ++blockIx) {
+                if (block(toIndex, blockIx).low > arrive) {
+                    continue;
+                }
+                auto    count = decodeBlock(toIndex, blockIx, arrives);
+                decodeBlock(fromIndex, blockIx, leaves);
+                for (size_t k = 0; k < count; ++k) {
+                    if (arrives[k] <= arrive && (rv == timeLinesCount_ || leaves[k] >= latest)) {
+                        rv = blockIx * blockSize + k;
+                        latest = leaves[k];
+                    }
+                }
+            }
+            return rv;
+        }
+        for (size_t i = 0; i < timeLinesCount_; ++i) {
+            if (timeTable_[i * stopCount_ + toIndex] <= arrive &&
+                (rv == timeLinesCount_ ||
+                 timeTable_[i * stopCount_ + fromIndex] >= timeTable_[rv * stopCount_ + fromIndex])) {
+
+                rv = i;
+            }
+        }
+        return rv;
+    }
+
+    if (compressed_) {
+        //  the last block starting by 'arrive', then the last time line in it.
+        auto    firstBlock = blocks_.cbegin() + toIndex * blockCount();
+        auto    blockIt = std::upper_bound(
+            firstBlock, firstBlock + blockCount(), arrive, [](Time t, const Block& b) {
+
+            return t < b.first;
+        });
+        if (blockIt == firstBlock) {
+            return timeLinesCount_;
+        }
+        size_t  blockIx = blockIt - firstBlock - 1;
+        Time    times[blockSize];
+        auto    timesCount = decodeBlock(toIndex, blockIx, times);
+        auto    it = std::upper_bound(times, times + timesCount, arrive);
+        return blockIx * blockSize + (it - times) - 1;
+    }
+
+    //  first time line after 'arrive'
+    size_t  first = 0;
+    size_t  count = timeLinesCount_;
+    while (count > 0) {
+        auto    step = count / 2;
+        auto    middle = first + step;
+        if (timeTable_[middle * stopCount_ + toIndex] <= arrive) {
+            first = middle + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first > 0 ? first - 1 : timeLinesCount_;
 }
@@ -3,48 +3,139 @@
 #define FRAGMENT_HPP
 
 #include <cassert>
+#include <cstdint>
 #include <iterator>
 #include <utility>
 #include <vector>
 
+#include "../utility/arena.hpp"
 #include "time.hpp"
 #include "time_line.hpp"
 
+//  Trips of a schedule sharing their first and last stops: a table with a time line per trip.
+//
+//  Once compress()ed, the table is kept as one column per stop, cut in blocks of blockSize
+//  trips. A block keeps its first time and, bit packed, the differences between consecutive
+//  times (zigzag encoded, since a trip may overtake another one), with the range of its times
+//  so that lookups decode only the blocks that may have what they look for.
 class Fragment {
 public:
+    static const size_t blockSize = 64;
+
+    //  On the heap, or on 'arena'.
+    Fragment(): Fragment{nullptr} {
+    }
+    explicit Fragment(Utility::Arena* arena):
+        stopCount_{0}, timeLinesCount_{0}, timeTable_{TimeTable::allocator_type{arena}}, compressed_{false},
+        overtaking_{false}, blocks_{Utility::ArenaAllocator<Block>{arena}},
+        packed_{Utility::ArenaAllocator<std::uint64_t>{arena}} {
+    }
+    //  Copy on 'arena'.
+    Fragment(const Fragment& other, Utility::Arena* arena):
+        stopCount_{other.stopCount_}, timeLinesCount_{other.timeLinesCount_},
+        timeTable_{other.timeTable_, TimeTable::allocator_type{arena}}, compressed_{other.compressed_},
+        overtaking_{other.overtaking_}, blocks_{other.blocks_, Utility::ArenaAllocator<Block>{arena}},
+        packed_{other.packed_, Utility::ArenaAllocator<std::uint64_t>{arena}} {
+    }
+
     void setStopCount(size_t stopCount) {
         stopCount_ = stopCount;
     }
+    //  Time lines are kept by departure time, so that, unless a trip overtakes another one, every
+    //  stop column is sorted.
     void addTimeLine(const TimeLine& tline) {
         assert(tline.size() == stopCount_);
+        assert(!compressed_);
 
-        timeTable_.insert(timeTable_.end(), tline.cbegin(), tline.cend());
+        size_t  ix = timeLinesCount_;
+        while (ix > 0 && timeTable_[(ix - 1) * stopCount_] > tline.front()) {
+            --ix;
+        }
+        for (size_t stopIx = 0; stopIx < stopCount_; ++stopIx) {
+            if ((ix > 0 && tline[stopIx] < timeTable_[(ix - 1) * stopCount_ + stopIx]) ||
+                (ix < timeLinesCount_ && tline[stopIx] > timeTable_[ix * stopCount_ + stopIx])) {
+
+                overtaking_ = true;
+            }
+        }
+        timeTable_.insert(timeTable_.begin() + ix * stopCount_, tline.cbegin(), tline.cend());
         ++timeLinesCount_;
 
         assert(timeTable_.size() == stopCount_ * timeLinesCount_);
     }
+    //  Replace the table by its compressed columns. No time line can be added afterwards.
+    void compress();
+
+    size_t stopCount() const {
+        return stopCount_;
+    }
+    size_t timeLinesCount() const {
+        return timeLinesCount_;
+    }
+    bool compressed() const {
+        return compressed_;
+    }
+    //  Bytes used by the times.
+    size_t memoryUsage() const {
+        return timeTable_.capacity() * sizeof(Time) + blocks_.capacity() * sizeof(Block) +
+            packed_.capacity() * sizeof(std::uint64_t);
+    }
 
     TimeLine getStopTimes(size_t stopIndex) const;
+    //  Every time, time line after time line. Once compressed, every block is decoded once: to
+    //  be used instead of getTime() to go through the table.
+    TimeLine getTimes() const;
 
+    //  Once compressed, decodes a block: to be used for a few times only.
     Time getTime(size_t timelineIx, size_t stopIx) const {
         assert(timelineIx < timeLinesCount_);
         assert(stopIx < stopCount_);
-        assert(timeTable_.size() == stopCount_ * timeLinesCount_);
 
+        if (compressed_) {
+            Time    times[blockSize];
+            decodeBlock(stopIx, timelineIx / blockSize, times);
+            return times[timelineIx % blockSize];
+        }
+        assert(timeTable_.size() == stopCount_ * timeLinesCount_);
         return timeTable_[timelineIx * stopCount_ + stopIx];
     }
 
     std::pair<Time, bool> findArriveTime(size_t fromIndex, Time leave, size_t toIndex) const;
+    //  Index of the time line leaving 'fromIndex' the latest while at 'toIndex' by 'arrive',
+    //  timeLinesCount() if none. A search in the column of 'toIndex', unless a trip overtakes
+    //  another one.
+    size_t findLatestTimeLine(size_t fromIndex, size_t toIndex, Time arrive) const;
+    std::pair<TimeLine, bool> findTimeLine(Time start) const;
 
 private:
-    using TimeTable = std::vector<Time>;
+    using TimeTable = Utility::ArenaVector<Time>;
     struct TimeTableIterator: std::forward_iterator_tag {
         TimeTableIterator();
     };
+    struct Block {
+        Time            first;
+        Time            low;
+        Time            high;
+        std::uint32_t   offset;     //  into packed_
+        std::uint8_t    width;      //  bits of a difference
+    };
+
+    size_t blockCount() const {
+        return (timeLinesCount_ + blockSize - 1) / blockSize;
+    }
+    const Block& block(size_t stopIndex, size_t blockIx) const {
+        return blocks_[stopIndex * blockCount() + blockIx];
+    }
+    //  Times of a block of a column into 'times'. Returns how many there are.
+    size_t decodeBlock(size_t stopIndex, size_t blockIx, Time* times) const;
 
-    size_t      stopCount_;
-    size_t      timeLinesCount_;
-    TimeTable   timeTable_;
+    size_t                              stopCount_;
+    size_t                              timeLinesCount_;
+    TimeTable                           timeTable_;
+    bool                                compressed_;
+    bool                                overtaking_;    //  some stop column is not sorted
+    Utility::ArenaVector<Block>         blocks_;        //  by stop, then by block
+    Utility::ArenaVector<std::uint64_t> packed_;
 };
 
 #endif // FRAGMENT_HPP
@@ -0,0 +1,28 @@
+#pragma once
+#ifndef JOURNEY_HPP
+#define JOURNEY_HPP
+
+#include <utility>
+#include <vector>
+
+#include "lines.hpp"
+#include "stop.hpp"
+#include "time.hpp"
+
+//  Result of the trip based engines, independent of the graph of BusNetwork: a sequence of
+//  legs, each one riding a route (or walking) through consecutive stops.
+struct JourneyLeg {
+    RouteId                             routeid;
+    std::vector<std::pair<Stop, Time>>  stops;
+};
+
+using Journey = std::vector<JourneyLeg>;
+
+inline Time departure(const Journey& journey) {
+    return journey.front().stops.front().second;
+}
+inline Time arrival(const Journey& journey) {
+    return journey.back().stops.back().second;
+}
+
+#endif // JOURNEY_HPP
@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 
+#include "../utility/arena.hpp"
 #include "route.hpp"
 
 using RouteName = std::string;
@@ -16,19 +17,43 @@ using StepsRoutes = std::vector<StepsByRoute>;
 
 class Line {
 public:
+    //  On the heap, or on 'arena' with its routes.
+    Line(): Line{nullptr} {
+    }
+    explicit Line(Utility::Arena* arena): routes_{std::less<RouteName>{}, Utility::ArenaAllocator<Route>{arena}} {
+    }
+    //  Copy on 'arena'.
+    Line(const Line& other, Utility::Arena* arena): Line{arena} {
+        Utility::copyOnArena(other.routes_, routes_);
+    }
+
     Route& addRoute(const std::string& rstr) {
-        return routes_[rstr];
+        return Utility::emplaceOnArena(routes_, rstr);
     }
     void removeRoute(const std::string& rstr) {
         routes_.erase(routes_.find(rstr));
     }
 
+    bool hasRoute(const RouteName& routen) const {
+        return routes_.count(routen) != 0;
+    }
     RouteNames getRouteNames() const {
         return getKeyVector(routes_);
     }
-    std::string getPlatform(const RouteName& routen, const Stop& stop) const {
+    const std::string& getPlatform(const RouteName& routen, const Stop& stop) const {
         return routes_.at(routen).getPlatform(stop);
     }
+    void compress() {
+        for (auto& routep: routes_) {
+            routep.second.compress();
+        }
+    }
+    template <typename Function>
+    void forEachRoute(Function function) const {
+        for (const auto& routep: routes_) {
+            function(routep.first, routep.second);
+        }
+    }
     StopSet getStopSet() const;
     StepsRoutes getForwardStepsRoutes() const;
     StepsRoutes getBackwardStepsRoutes() const;
@@ -36,15 +61,24 @@ public:
         return routes_.at(routen).getStopTimes(day, stop);
     }
     TimeLine getStopTimes(Day day, const Stop& stop) const;
-    Time getArriveTime(Day day, const RouteName& routen, const Stop& from, Time leave, const Stop& to) const {
-        return routes_.at(routen).getArriveTime(day, from, leave, to);
+    Time getArriveTime(
+        Day day, const RouteName& routen, const Stop& from, Time leave, const Stop& to,
+        const ServiceCalendar& calendar) const {
+
+        return routes_.at(routen).getArriveTime(day, from, leave, to, calendar);
+    }
+    ServiceTimes getServiceStopTimes(const RouteName& routen, const Stop& stop) const {
+        return routes_.at(routen).getServiceStopTimes(stop);
+    }
+    TripStopTimes getTripTimes(Day day, const RouteName& routen, Time start) const {
+        return routes_.at(routen).getTripTimes(day, start);
     }
     std::string getRouteDescription(const RouteName& routen) const {
         return routes_.at(routen).description();
     }
 
 private:
-    std::map<RouteName, Route>  routes_;
+    Utility::ArenaMap<RouteName, Route> routes_;
 };
 
 
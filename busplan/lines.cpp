@@ -2,6 +2,38 @@
 
 #include "lines.hpp"
 
+Lines::Lines(): Lines{std::make_shared<Utility::Arena>()} {
+}
+
+Lines::Lines(std::shared_ptr<Utility::Arena> arena):
+    arena_{std::move(arena)},
+    lines_{std::less<LineName>{}, Utility::ArenaAllocator<Line>{arena_.get()}},
+    walkingTimes_{std::less<WalkingStep>{}, Utility::ArenaAllocator<DifTime>{arena_.get()}},
+    stopCoordinates_{std::less<Stop>{}, Utility::ArenaAllocator<Coordinates>{arena_.get()}}, calendar_{} {
+}
+
+Lines::Lines(const Lines& other): Lines{} {
+    Utility::copyOnArena(other.lines_, lines_);
+    walkingTimes_.insert(other.walkingTimes_.cbegin(), other.walkingTimes_.cend());
+    stopCoordinates_.insert(other.stopCoordinates_.cbegin(), other.stopCoordinates_.cend());
+    calendar_ = other.calendar_;
+}
+
+Lines& Lines::operator=(const Lines& other) {
+    return *this = Lines{other};
+}
+
+Lines& Lines::operator=(Lines&& other) {
+    //  The old arena must outlive the destruction of the old containers.
+    auto    arena = std::move(arena_);
+    lines_ = std::move(other.lines_);
+    walkingTimes_ = std::move(other.walkingTimes_);
+    stopCoordinates_ = std::move(other.stopCoordinates_);
+    calendar_ = std::move(other.calendar_);
+    arena_ = std::move(other.arena_);
+    return *this;
+}
+
 StopSet Lines::getStopSet() const {
     StopSet rv;
     for (const auto& linep: lines_) {
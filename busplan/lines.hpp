@@ -3,9 +3,12 @@
 #define LINES_HPP
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "../utility/arena.hpp"
+#include "calendar.hpp"
 #include "line.hpp"
 #include "stop.hpp"
 #include "walking.hpp"
@@ -28,21 +31,81 @@ inline bool operator ==(const RouteId& rida, const RouteId& ridb) {
 inline bool operator !=(const RouteId& rida, const RouteId& ridb) {
     return !(rida == ridb);
 }
+inline bool operator <(const RouteId& rida, const RouteId& ridb) {
+    return rida.linen < ridb.linen || (rida.linen == ridb.linen && rida.routen < ridb.routen);
+}
 
 const RouteId   walkingRouteId{"__walking__", "__"};
+//  Time allowed to change from one route to another. The graph search of BusNetwork counts it
+//  from the departure of the step before the change, since it does not know the arrival times:
+//  its changes may be shorter than the ones of the other engines, which count it from the
+//  arrival. Their plans may leave earlier than its plans.
+const DifTime   transferTime = std::chrono::minutes{5};
 
+//  The whole model lives in an arena owned by Lines: every line, route, schedule and fragment
+//  added is constructed on it, and it is released at once with the last copy of the Lines. The
+//  model is only modified while loading, since the arena is not thread safe.
 class Lines {
 public:
+    Lines();
+    //  On 'arena' rather than on a new one.
+    explicit Lines(std::shared_ptr<Utility::Arena> arena);
+    //  Deep copy into a new arena.
+    Lines(const Lines& other);
+    Lines(Lines&& other) = default;
+    Lines& operator=(const Lines& other);
+    Lines& operator=(Lines&& other);
+
+    Utility::Arena& arena() {
+        return *arena_;
+    }
+    const Utility::Arena& arena() const {
+        return *arena_;
+    }
+
     Line& addLine(const LineName& lname) {
-        return lines_[lname];
+        return Utility::emplaceOnArena(lines_, lname);
     }
     void removeLine(const LineName& lname) {
         lines_.erase(lines_.find(lname));
     }
 
+    //  Keep the timetables compressed (see Fragment). Copy the Lines afterwards to release the
+    //  memory of the expanded ones, which the arena keeps.
+    void compress() {
+        for (auto& linep: lines_) {
+            linep.second.compress();
+        }
+    }
+    //  Bytes used by the times of the timetables.
+    size_t timetableMemoryUsage() const {
+        size_t  rv = 0;
+        forEachRoute([&rv](const RouteId&, const Route& route) {
+            rv += route.memoryUsage();
+        });
+        return rv;
+    }
+
     WalkingTimes& walkingTimes() {
         return walkingTimes_;
     }
+    const WalkingTimes& walkingTimes() const {
+        return walkingTimes_;
+    }
+    //  Services of the trips that do not run by weekday.
+    ServiceCalendar& calendar() {
+        return calendar_;
+    }
+    const ServiceCalendar& calendar() const {
+        return calendar_;
+    }
+    //  Positions of the stops that have one.
+    StopCoordinates& stopCoordinates() {
+        return stopCoordinates_;
+    }
+    const StopCoordinates& stopCoordinates() const {
+        return stopCoordinates_;
+    }
 
     LineNames getLineNames() const {
         return getKeyVector(lines_);
@@ -50,12 +113,28 @@ public:
     RouteNames getRouteNames(const LineName& linen) const {
         return lines_.at(linen).getRouteNames();
     }
-    std::string getPlatform(const RouteId& routeid, const Stop& stop) const {
+    const std::string& getPlatform(const RouteId& routeid, const Stop& stop) const {
         if (routeid == walkingRouteId) {
-            return "walking";
+            return walkingPlatform();
         }
+        return getRoutePlatform(routeid, stop);
+    }
+    //  Platforms of a walk, and of a bus route, for callers that know which one they have.
+    static const std::string& walkingPlatform() {
+        static const std::string    walking{"walking"};
+        return walking;
+    }
+    const std::string& getRoutePlatform(const RouteId& routeid, const Stop& stop) const {
         return lines_.at(routeid.linen).getPlatform(routeid.routen, stop);
     }
+    template <typename Function>
+    void forEachRoute(Function function) const {
+        for (const auto& linep: lines_) {
+            linep.second.forEachRoute([&linep, &function](const RouteName& routen, const Route& route) {
+                function(RouteId{linep.first, routen}, route);
+            });
+        }
+    }
     StopSet getStopSet() const;
     StepsLines getForwardStepsLines() const;
     StepsLines getBackwardStepsLines() const;
@@ -68,7 +147,21 @@ public:
         if (routeid == walkingRouteId) {
             return ::getArriveTime(walkingTimes_, from, leave, to);
         }
-        return lines_.at(routeid.linen).getArriveTime(day, routeid.routen, from, leave, to);
+        return getRouteArriveTime(day, routeid, from, leave, to);
+    }
+    //  Trips of the calendar services are only known to run on a date.
+    Time getRouteArriveTime(Day day, const RouteId& routeid, const Stop& from, Time leave, const Stop& to) const {
+        return lines_.at(routeid.linen).getArriveTime(day, routeid.routen, from, leave, to, calendar_);
+    }
+    ServiceTimes getServiceStopTimes(const RouteId& routeid, const Stop& stop) const {
+        return lines_.at(routeid.linen).getServiceStopTimes(routeid.routen, stop);
+    }
+    TripStopTimes getTripTimes(Day day, const RouteId& routeid, Time start) const {
+        auto    lineIt = lines_.find(routeid.linen);
+        if (lineIt == lines_.cend() || !lineIt->second.hasRoute(routeid.routen)) {
+            return TripStopTimes{};
+        }
+        return lineIt->second.getTripTimes(day, routeid.routen, start);
     }
     std::string getRouteDescription(const RouteId& routeid) const {
         if (routeid == walkingRouteId) {
@@ -81,8 +174,11 @@ public:
     }
 
 private:
-    std::map<LineName, Line>    lines_;
-    WalkingTimes                walkingTimes_;
+    std::shared_ptr<Utility::Arena>     arena_;
+    Utility::ArenaMap<LineName, Line>   lines_;
+    WalkingTimes                        walkingTimes_;
+    StopCoordinates                     stopCoordinates_;
+    ServiceCalendar                     calendar_;
 };
 
 #endif // LINES_HPP
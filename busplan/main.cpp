@@ -1,7 +1,13 @@
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+#include <sys/resource.h>
 
 #include <boost/program_options/cmdline.hpp>
 #include <boost/program_options/errors.hpp>
@@ -14,66 +20,225 @@
 #include "bus_network.hpp"
 #include "config.hpp"
 #include "day.hpp"
+#include "delays.hpp"
 #include "details.hpp"
+#include "engine.hpp"
+#include "federation.hpp"
 #include "lines.hpp"
 #include "options.hpp"
+#include "query_log.hpp"
+#include "stats.hpp"
+#ifdef STATIC_NETWORK
+#include "static_network.hpp"
+#endif
+
+namespace {
+
+void printPlanHeader(std::ostream& os) {
+    os << "From\tLeave\tRoute\tTo\tArrive" << std::endl;
+}
+
+void printPlanNode(std::ostream& os, const BusNetwork::Node& node, const StopDescriptions& stopdescs) {
+    //  from
+    if (node.from.platform.empty()) {
+        os << stopdescs.at(node.from.stop)[0] << "\t";
+    } else {
+        os << node.from.platform << "\t";
+    }
+    //  leave
+    os << toString(node.from.time) << "\t";
+    //  route
+    os << node.routeid.linen;
+    if (!node.routeid.routen.empty()) {
+        os << " [" << node.routeid.routen << "]";
+    }
+    os << "\t";
+    //  to
+    if (node.to.platform.empty()) {
+        os << stopdescs.at(node.to.stop)[0] << "\t";
+    } else {
+        os << node.to.platform;
+    }
+    //  arrive
+    os << toString(node.to.time);
+
+    os << std::endl;
+}
+
+//  A stop, a group of the configuration, a position "latitude,longitude" or a list of stops
+//  "stop,stop...", in this order.
+BusNetwork::Place toPlace(const std::string& str, const StopDescriptions& stopdescs, const StopGroups& groups) {
+    if (stopdescs.count(str)) {
+        return BusNetwork::Place{str};
+    }
+    auto        groupIt = groups.find(str);
+    if (groupIt != groups.cend()) {
+        return BusNetwork::Place{groupIt->second};
+    }
+    Coordinates position;
+    if (parseCoordinates(str, position)) {
+        return BusNetwork::Place{position};
+    }
+    Stops       stops;
+    for (const auto& item: Utility::Literal{str}.asList()) {
+        stops.push_back(item);
+    }
+    return BusNetwork::Place{stops};
+}
 
-std::string MissingOption::toString(const OptionNameList& optionNames) {
-    assert(!optionNames.empty());
+//  Whether planning between 'from' and 'to' takes more than one stop at either end.
+bool manyStops(const BusNetwork::Place& from, const BusNetwork::Place& to) {
+    return from.stops.size() != 1 || to.stops.size() != 1;
+}
 
-    std::string rv{quote(optionNames.at(0))};
-    std::for_each(optionNames.cbegin() + 1, optionNames.cend(), [&rv](const std::string& optionName) {
-        rv.append(", ").append(quote(optionName));
-    });
-    return rv;
+void printPlan(std::ostream& os, const BusNetwork::NodeList& routelist, const StopDescriptions& stopdescs) {
+    printPlanHeader(os);
+    for (const auto& node: routelist) {
+        printPlanNode(os, node, stopdescs);
+    }
 }
 
-std::string MissingOption::quote(const std::string& str) {
-    return std::string("'").append(str).append("'");
+void printPlans(std::ostream& os, const BusNetwork::Table& plans, const StopDescriptions& stopdescs) {
+    if (plans.empty()) {
+        printPlanHeader(os);
+    }
+    for (const auto& plan: plans) {
+        printPlan(os, plan, stopdescs);
+    }
 }
 
-void getConfig(Utility::IniDoc& config, const std::string& fname) {
-    std::ifstream   cfgf(fname);
-    if (!cfgf.is_open()) {
-        throw std::runtime_error(
-            std::string{"Unable to open \""}.append(fname).append("\""));
+void printTable(
+    std::ostream& os, const BusNetwork::Table& table, const BusNetwork& busNetwork, const StopDescriptions& stopdescs) {
+
+    for (const auto& nodeList: table) {
+        for (const auto& node: nodeList) {
+            //  from
+            if (node.from.platform.empty()) {
+                os << stopdescs.at(node.from.stop)[0] << "\t";
+            } else {
+                os << node.from.platform << "\t";
+            }
+            //  leave
+            os << toString(node.from.time) << "\t";
+            //  route
+            os << node.routeid.linen;
+            if (!node.routeid.routen.empty()) {
+                os << " [" << busNetwork.routeName(node.routeid) << "]";
+            }
+            os << "\t";
+            //  to
+            if (node.to.platform.empty()) {
+                os << stopdescs.at(node.to.stop)[0] << "\t";
+            } else {
+                os << node.to.platform;
+            }
+            //  arrive
+            os << toString(node.to.time) << "\t";
+        }
+        os << std::endl;
     }
-    cfgf >> config;
 }
 
-void resolveImports(Utility::IniDoc& config) {
-    if (config.doc().at("").count("imports")) {
-        const auto& importList = config.doc().at("").at("imports").items();
-        for (const auto& importstr: importList) {
-            Utility::IniDoc iconfig;
-            getConfig(iconfig, importstr);
-            resolveImports(iconfig);
-            config.merge(iconfig, Utility::IniDoc::DuplicateAction::combineProperty);
+//  get-plan, and the get-plan queries of batch, across the partitions of the federation of
+//  'fname' (see Federation).
+int planFederated(
+    const std::string& fname, Command cmd, const Stop& fromStop, const Stop& toStop, Time arrive, Day day,
+    Details details) {
+
+    std::unique_ptr<Federation> federation;
+    try {
+        federation = readFederation(fname);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+    auto    stopdescs = federation->stopDescriptions();
+
+    if (cmd == Command::getPlan) {
+        BusNetwork::NodeList    plan;
+        try {
+            plan = federation->planFromArrive(day, fromStop, toStop, arrive, details);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 2;
         }
+        printPlan(std::cout, plan, stopdescs);
+        return 0;
+    }
+    if (cmd == Command::batch) {
+        Query       query;
+        std::string line;
+        while (readQuery(std::cin, day, query, line)) {
+            std::cout << "; " << line << std::endl;
+            try {
+                if (query.command != Command::getPlan) {
+                    throw std::invalid_argument("Only get-plan queries are planned across partitions");
+                }
+                auto    plan = federation->planFromArrive(query.day, query.from, query.to, query.arrive, details);
+                printPlan(std::cout, plan, stopdescs);
+            } catch (const std::exception& e) {
+                std::cerr << line << ": " << e.what() << std::endl;
+            }
+        }
+        return 0;
     }
+    std::cerr << "Only get-plan and batch plan across partitions" << std::endl;
+    return 2;
+}
+
 }
 
 int main(int argc, char *argv[])
 {
     namespace po = boost::program_options;
 
-    std::string fromStop, toStop;
+    //  unsynchronized, std::cin tells how much input is waiting (see batch and readDelays()).
+    std::ios_base::sync_with_stdio(false);
+
+    std::string fromStop, toStop, delaysFile, indexFile, federationFile;
+    size_t      nearStops, cacheSize, alternatives;
+    unsigned    cacheTtl, cacheBucket;
+    double      nearRadius;
     Time        arriveTime;
     Day         day;
     Command     cmd;
     Details     details;
+    Engine      engine;
 
     po::options_description command_desc("Command");
     command_desc.add_options()
         ("command",
-            po::value<Command>(&cmd)->value_name("command")->required(), "{help|get-plan|get-lines|get-routes|get-table}");
+            po::value<Command>(&cmd)->value_name("command")->required(), "{help|batch|preprocess|get-plan|get-lines|get-routes|get-table}");
     po::options_description option_desc("Options");
     option_desc.add_options()
-        ("from", po::value<std::string>(&fromStop)->value_name("BUS-STOP"))
-        ("to", po::value<std::string>(&toStop)->value_name("BUS-STOP"))
+        ("from", po::value<std::string>(&fromStop)->value_name("BUS-STOP"),
+            "a stop, a group, STOP,STOP... or LATITUDE,LONGITUDE")
+        ("to", po::value<std::string>(&toStop)->value_name("BUS-STOP"),
+            "a stop, a group, STOP,STOP... or LATITUDE,LONGITUDE")
+        ("near-stops", po::value<size_t>(&nearStops)->value_name("N")->default_value(4),
+            "stops walked from or to a position")
+        ("near-radius", po::value<double>(&nearRadius)->value_name("METRES")->default_value(500.0),
+            "farthest stop walked from or to a position")
         ("arrive", po::value<Time>(&arriveTime)->value_name("TIME"))
         ("date", po::value<Day>(&day)->value_name("DATE")->default_value(Day{"today"}))
         ("details", po::value<Details>(&details)->value_name("DETAILS")->default_value(Details::steps))
+        ("delays", po::value<std::string>(&delaysFile)->value_name("FILE"), "delay feed ('-' for stdin)")
+        ("stats", "print per phase timings and counters to stderr")
+        ("engine", po::value<Engine>(&engine)->value_name("ENGINE")->default_value(Engine::dijkstra),
+            "dijkstra, trip-based, transfer-patterns or connection-scan")
+        ("index", po::value<std::string>(&indexFile)->value_name("FILE"),
+            "data of the engine, written by preprocess")
+        ("prefer-direct", "plan a journey without change whenever there is one")
+        ("alternatives", po::value<size_t>(&alternatives)->value_name("K")->default_value(1),
+            "plans between two stops, the best one and up to K - 1 different ones")
+        ("federation", po::value<std::string>(&federationFile)->value_name("FILE"),
+            "plan across the partitions of FILE rather than busplan.cfg (get-plan and batch)")
+        ("cache-size", po::value<size_t>(&cacheSize)->value_name("N")->default_value(0),
+            "plans kept to answer repeated queries (0 for none)")
+        ("cache-ttl", po::value<unsigned>(&cacheTtl)->value_name("SECONDS")->default_value(300),
+            "longest a plan is kept")
+        ("cache-bucket", po::value<unsigned>(&cacheBucket)->value_name("MINUTES")->default_value(1),
+            "arrival times planned as the start of their bucket while caching")
         ;
     po::positional_options_description  cmdDesc;
     cmdDesc.add("command", 1);
@@ -102,14 +267,28 @@ int main(int argc, char *argv[])
         return 0;
     }
 
-    Utility::IniDoc     config;
+    if (!federationFile.empty()) {
+        return planFederated(federationFile, cmd, fromStop, toStop, arriveTime, day, details);
+    }
+
     Lines               lines;
     StopDescriptions    stopdescs;
+    StopGroups          groups;
+    double              speed = defaultWalkingSpeed;
 
     try {
+#ifdef STATIC_NETWORK
+        //  the network linked in by netcode (see busplan.pro) rather than busplan.cfg.
+        read(staticNetwork(), lines, stopdescs, groups);
+        speed = staticNetwork().walkingSpeed;
+#else
+        Utility::IniDoc config;
         getConfig(config, "busplan.cfg");
         resolveImports(config);
         read(config.doc(), lines, stopdescs);
+        read(config.doc(), groups);
+        speed = walkingSpeed(config.doc());
+#endif
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return 2;
@@ -117,6 +296,64 @@ int main(int argc, char *argv[])
 
     BusNetwork  busNetwork{std::move(lines)};
 
+    try {
+        if (cmd == Command::preprocess) {
+            if (engine == Engine::dijkstra) {
+                throw std::runtime_error("The dijkstra engine has nothing to preprocess");
+            }
+            if (engine == Engine::connectionScan) {
+                throw std::runtime_error("The connection-scan engine has nothing to preprocess");
+            }
+            auto    start = std::chrono::steady_clock::now();
+            busNetwork.setEngine(engine);
+            std::chrono::duration<double>   elapsed = std::chrono::steady_clock::now() - start;
+
+            std::ofstream   indexf(indexFile, std::ios::binary);
+            if (!indexf.is_open()) {
+                throw std::runtime_error(std::string{"Unable to open \""}.append(indexFile).append("\""));
+            }
+            busNetwork.writeIndex(indexf);
+            indexf.close();
+
+            rusage  usage;
+            getrusage(RUSAGE_SELF, &usage);
+            std::cout << engine << ": " << elapsed.count() << " s, ";
+            std::cout << busNetwork.indexMemoryUsage() / 1024 << " KiB in memory, ";
+            std::cout << "peak RSS " << usage.ru_maxrss << " KiB" << std::endl;
+            return 0;
+        }
+        if (engine != Engine::dijkstra && engine != Engine::connectionScan && !indexFile.empty()) {
+            std::ifstream   indexf(indexFile, std::ios::binary);
+            if (!indexf.is_open()) {
+                throw std::runtime_error(std::string{"Unable to open \""}.append(indexFile).append("\""));
+            }
+            busNetwork.readIndex(engine, indexf);
+        } else {
+            busNetwork.setEngine(engine);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    busNetwork.preferDirect(vm.count("prefer-direct") != 0);
+    busNetwork.setAccess(nearStops, nearRadius, speed);
+    busNetwork.setCache(cacheSize, std::chrono::seconds{cacheTtl}, DifTime{cacheBucket});
+
+    if (!delaysFile.empty()) {
+        busNetwork.delays().beginServiceDay(day);
+        if (delaysFile == "-") {
+            readDelays(std::cin, busNetwork.lines(), busNetwork.delays());
+        } else {
+            std::ifstream   delaysf(delaysFile);
+            if (!delaysf.is_open()) {
+                std::cerr << "Unable to open \"" << delaysFile << "\"" << std::endl;
+                return 2;
+            }
+            readDelays(delaysf, busNetwork.lines(), busNetwork.delays());
+        }
+    }
+
     if (cmd == Command::getLines) {
         auto    linesn = busNetwork.getLineNames();
         std::cout << "Lines:" << std::endl;
@@ -145,71 +382,209 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (cmd == Command::getPlan) {
-        auto    routelist = busNetwork.planFromArrive(day, fromStop, toStop, arriveTime, details);
+    QueryStats      queryStats;
+    QueryStats*     stats = vm.count("stats") ? &queryStats : nullptr;
+    countAllocations(stats != nullptr);
 
-        std::cout << "From\tLeave\tRoute\tTo\tArrive" << std::endl;
-        for (const auto& node: routelist) {
-            //  from
-            if (node.from.platform.empty()) {
-                std::cout << stopdescs.at(node.from.stop)[0] << "\t";
-            } else {
-                std::cout << node.from.platform << "\t";
-            }
-            //  leave
-            std::cout << toString(node.from.time) << "\t";
-            //  route
-            std::cout << node.routeid.linen;
-            if (!node.routeid.routen.empty()) {
-                std::cout << " [" << node.routeid.routen << "]";
-            }
-            std::cout << "\t";
-            //  to
-            if (node.to.platform.empty()) {
-                std::cout << stopdescs.at(node.to.stop)[0] << "\t";
+    if (cmd == Command::getPlan) {
+        auto    from = toPlace(fromStop, stopdescs, groups);
+        auto    to = toPlace(toStop, stopdescs, groups);
+        BusNetwork::Table   plans;
+        try {
+            if (alternatives > 1 && !manyStops(from, to)) {
+                plans = busNetwork.planAlternatives(day, fromStop, toStop, arriveTime, alternatives, details, stats);
             } else {
-                std::cout << node.to.platform;
+                plans.push_back(manyStops(from, to) ?
+                    busNetwork.planFromArrive(day, from, to, arriveTime, details, stats) :
+                    busNetwork.planFromArrive(day, fromStop, toStop, arriveTime, details, stats));
             }
-            //  arrive
-            std::cout << toString(node.to.time);
-
-            std::cout << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 2;
         }
+
+        ScopedTimer outputTimer{stats, Phase::output};
+        printPlans(std::cout, plans, stopdescs);
     }
 
     if (cmd == Command::getTable) {
-        auto    table = busNetwork.table(day, fromStop, toStop, details);
+        auto    table = busNetwork.table(day, fromStop, toStop, details, stats);
+
+        ScopedTimer outputTimer{stats, Phase::output};
+        printTable(std::cout, table, busNetwork, stopdescs);
+    }
 
-        for (const auto& nodeList: table) {
-            for (const auto& node: nodeList) {
-                //  from
-                if (node.from.platform.empty()) {
-                    std::cout << stopdescs.at(node.from.stop)[0] << "\t";
+    if (cmd == Command::batch) {
+        StatsHistograms             histograms;
+        BusNetwork::QueryContext    context;
+        //  The queries already waiting in the input are answered together: with the connection
+        //  scan engine, the plans on the same day between the same stops by one scan, with the
+        //  graph search, the plans on the same day to the same stop by the same time by one
+        //  search from there. Their stats are recorded once for the whole group, and the plans
+        //  are printed in input order.
+        struct Pending {
+            std::string line;
+            Query       query;
+            size_t      group;
+            size_t      slot;
+        };
+        struct Group {
+            std::vector<size_t> members;
+            BusNetwork::Table   plans;
+            QueryStats          stats;
+            bool                failed;
+        };
+        using GroupKey = std::tuple<size_t, Date, Stop, Stop, Time>;
+        const auto              noGroup = static_cast<size_t>(-1);
+        std::vector<Pending>    pending;
+        std::vector<Group>      shared;
+        std::map<GroupKey, size_t>  groupIndex;
+
+        auto    answer = [&](const std::string& line, const Query& query) {
+            queryStats.clear();
+            std::cout << "; " << line << std::endl;
+            try {
+                auto    from = toPlace(query.from, stopdescs, groups);
+                auto    to = toPlace(query.to, stopdescs, groups);
+                if (query.command == Command::getPlan && manyStops(from, to)) {
+                    auto    routelist = busNetwork.planFromArrive(query.day, from, to, query.arrive, details, stats);
+
+                    ScopedTimer outputTimer{stats, Phase::output};
+                    printPlan(std::cout, routelist, stopdescs);
+                } else if (query.command == Command::getPlan && alternatives > 1) {
+                    auto    plans = busNetwork.planAlternatives(
+                        query.day, query.from, query.to, query.arrive, alternatives, details, stats);
+
+                    ScopedTimer outputTimer{stats, Phase::output};
+                    printPlans(std::cout, plans, stopdescs);
+                } else if (query.command == Command::getPlan) {
+                    //  nothing is printed for failed queries
+                    bool    header = false;
+                    busNetwork.planFromArrive(
+                        context, query.day, query.from, query.to, query.arrive, details,
+                        [stats, &stopdescs, &header](const BusNetwork::Node& node) {
+                            ScopedTimer outputTimer{stats, Phase::output};
+                            if (!header) {
+                                printPlanHeader(std::cout);
+                                header = true;
+                            }
+                            printPlanNode(std::cout, node, stopdescs);
+                        },
+                        stats);
+                    if (!header) {
+                        printPlanHeader(std::cout);
+                    }
                 } else {
-                    std::cout << node.from.platform << "\t";
-                }
-                //  leave
-                std::cout << toString(node.from.time) << "\t";
-                //  route
-                std::cout << node.routeid.linen;
-                if (!node.routeid.routen.empty()) {
-                    std::cout << " [" << busNetwork.routeName(node.routeid) << "]";
+                    auto    table = busNetwork.table(query.day, query.from, query.to, details, stats);
+
+                    ScopedTimer outputTimer{stats, Phase::output};
+                    printTable(std::cout, table, busNetwork, stopdescs);
                 }
-                std::cout << "\t";
-                //  to
-                if (node.to.platform.empty()) {
-                    std::cout << stopdescs.at(node.to.stop)[0] << "\t";
+            } catch (const std::exception& e) {
+                std::cerr << line << ": " << e.what() << std::endl;
+                return;
+            }
+            if (stats) {
+                histograms.record(queryStats);
+            }
+        };
+        //  A group that fails is answered query by query, each with its own error.
+        auto    plan_group = [&](Group& group) {
+            const auto& first = pending[group.members.front()].query;
+            auto        groupStats = stats ? &group.stats : nullptr;
+            try {
+                if (engine == Engine::connectionScan) {
+                    std::vector<Time>   arrives;
+                    for (auto member: group.members) {
+                        arrives.push_back(pending[member].query.arrive);
+                    }
+                    group.plans = busNetwork.planFromArrive(first.day, first.from, first.to, arrives, details, groupStats);
                 } else {
-                    std::cout << node.to.platform;
+                    Stops   froms;
+                    for (auto member: group.members) {
+                        froms.push_back(pending[member].query.from);
+                    }
+                    group.plans = busNetwork.planFromArrive(
+                        first.day, froms, first.to, first.arrive, details, groupStats);
+                }
+            } catch (const std::exception&) {
+                group.failed = true;
+            }
+        };
+
+        bool    more = true;
+        while (more) {
+            pending.clear();
+            shared.clear();
+            groupIndex.clear();
+            do {
+                Query       query;
+                std::string line;
+                try {
+                    more = readQuery(std::cin, day, query, line);
+                } catch (const std::invalid_argument& e) {
+                    std::cerr << e.what() << std::endl;
+                    continue;
+                }
+                if (!more) {
+                    break;
+                }
+                Pending entry{line, query, noGroup, 0};
+                //  unknown stops are left to fail on their own.
+                auto    grouped =
+                    (engine == Engine::connectionScan || engine == Engine::dijkstra) &&
+                    query.command == Command::getPlan && alternatives == 1 &&
+                    !manyStops(toPlace(query.from, stopdescs, groups), toPlace(query.to, stopdescs, groups)) &&
+                    busNetwork.hasStop(query.from) && busNetwork.hasStop(query.to);
+                if (grouped) {
+                    auto    key = engine == Engine::connectionScan ?
+                        GroupKey{query.day, query.day.date(), query.from, query.to, Time{}} :
+                        GroupKey{query.day, query.day.date(), Stop{}, query.to, query.arrive};
+                    auto    inserted = groupIndex.emplace(key, shared.size());
+                    if (inserted.second) {
+                        shared.push_back(Group{{}, {}, {}, false});
+                    }
+                    entry.group = inserted.first->second;
+                    entry.slot = shared[entry.group].members.size();
+                    shared[entry.group].members.push_back(pending.size());
+                }
+                pending.push_back(std::move(entry));
+            } while (std::cin.rdbuf()->in_avail() > 0);
+
+            for (size_t ix = 0; ix < pending.size(); ++ix) {
+                const auto& entry = pending[ix];
+                if (entry.group == noGroup || shared[entry.group].members.size() == 1) {
+                    answer(entry.line, entry.query);
+                    continue;
+                }
+                auto&   group = shared[entry.group];
+                if (ix == group.members.front()) {
+                    plan_group(group);
+                }
+                if (group.failed) {
+                    answer(entry.line, entry.query);
+                    continue;
+                }
+                ScopedTimer outputTimer{stats ? &group.stats : nullptr, Phase::output};
+                std::cout << "; " << entry.line << std::endl;
+                printPlan(std::cout, group.plans[entry.slot], stopdescs);
+                outputTimer.stop();
+                if (stats && ix == group.members.back()) {
+                    histograms.record(group.stats);
                 }
-                //  arrive
-                std::cout << toString(node.to.time) << "\t";
             }
-            std::cout << std::endl;
         }
+        if (stats) {
+            std::cerr << histograms;
+            if (cacheSize) {
+                std::cerr << "cache: " << busNetwork.cacheHits() << " hits, " << busNetwork.cacheMisses() << " misses";
+                std::cerr << std::endl;
+            }
+        }
+    } else if (stats) {
+        std::cerr << queryStats;
     }
 
-
     return 0;
 }
 
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cassert>
 #include <map>
 #include <stdexcept>
 #include <string>
@@ -5,14 +7,30 @@
 
 #include "options.hpp"
 
+std::string MissingOption::toString(const OptionNameList& optionNames) {
+    assert(!optionNames.empty());
+
+    std::string rv{quote(optionNames.at(0))};
+    std::for_each(optionNames.cbegin() + 1, optionNames.cend(), [&rv](const std::string& optionName) {
+        rv.append(", ").append(quote(optionName));
+    });
+    return rv;
+}
+
+std::string MissingOption::quote(const std::string& str) {
+    return std::string("'").append(str).append("'");
+}
+
 namespace {
 
 const std::map<std::string, Command>  cmdMap = {
     {"help", Command::help},
+    {"batch", Command::batch},
     {"get-line", Command::getLines},
     {"get-plan", Command::getPlan},
     {"get-route", Command::getRoutes},
-    {"get-table", Command::getTable}
+    {"get-table", Command::getTable},
+    {"preprocess", Command::preprocess}
 };
 
 }
@@ -50,6 +68,11 @@ void validate(const boost::program_options::variables_map& vm) {
     switch (command) {
     case Command::help:
         break;
+    case Command::batch:
+        break;
+    case Command::preprocess:
+        checkForMissing("preprocess", {"index"});
+        break;
     case Command::getPlan:
         checkForMissing("get-plan", {"from", "to", "arrive"});
         break;
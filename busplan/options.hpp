@@ -20,6 +20,8 @@ using Option = Options::value_type;
 
 enum class Command {
     help,
+    batch,
+    preprocess,
 
     getPlan,
     getLines,
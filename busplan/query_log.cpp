@@ -0,0 +1,44 @@
+#include <sstream>
+#include <stdexcept>
+
+#include "query_log.hpp"
+
+Query parseQuery(const std::string& line, Day defaultDay) {
+    std::istringstream  iss{line};
+    std::string         cmdstr, timestr, daystr;
+    Query               rv{Command::help, Stop{}, Stop{}, Time{}, defaultDay};
+    if (!(iss >> cmdstr >> rv.from >> rv.to >> timestr)) {
+        throw std::invalid_argument{std::string{"invalid query: \""}.append(line).append("\"")};
+    }
+    try {
+        std::istringstream  cmdss{cmdstr};
+        cmdss >> rv.command;
+        if (timestr != "-") {
+            rv.arrive = toTime(timestr);
+        }
+    } catch (const std::exception&) {
+        throw std::invalid_argument{std::string{"invalid query: \""}.append(line).append("\"")};
+    }
+    if (rv.command != Command::getPlan && rv.command != Command::getTable) {
+        throw std::invalid_argument{std::string{"unsupported query command: \""}.append(cmdstr).append("\"")};
+    }
+    if (rv.command == Command::getPlan && timestr == "-") {
+        throw std::invalid_argument{std::string{"get-plan query without time: \""}.append(line).append("\"")};
+    }
+    if (iss >> daystr) {
+        rv.day = Day{daystr};
+    }
+    return rv;
+}
+
+bool readQuery(std::istream& is, Day defaultDay, Query& query, std::string& line) {
+    while (std::getline(is, line)) {
+        auto    first = line.find_first_not_of(" \t");
+        if (first == line.npos || line[first] == ';') {
+            continue;
+        }
+        query = parseQuery(line, defaultDay);
+        return true;
+    }
+    return false;
+}
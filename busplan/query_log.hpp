@@ -0,0 +1,29 @@
+#pragma once
+#ifndef QUERY_LOG_HPP
+#define QUERY_LOG_HPP
+
+#include <istream>
+#include <string>
+
+#include "day.hpp"
+#include "options.hpp"
+#include "stop.hpp"
+#include "time.hpp"
+
+//  A query as written in batch input and query logs, one per line:
+//      <command> <from> <to> <time>|- [<day>]
+//  Empty lines and lines starting with ';' are skipped.
+struct Query {
+    Command command;
+    Stop    from;
+    Stop    to;
+    Time    arrive;
+    Day     day;
+};
+
+//  Throws std::invalid_argument if the line is not a valid query.
+Query parseQuery(const std::string& line, Day defaultDay);
+//  Read the next query, skipping empty and comment lines. 'line' receives its text.
+bool readQuery(std::istream& is, Day defaultDay, Query& query, std::string& line);
+
+#endif // QUERY_LOG_HPP
@@ -0,0 +1,38 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "route.hpp"
+
+Time Route::getArriveTime(
+    Day day, const Stop& from, Time leave, const Stop& to, const ServiceCalendar& calendar) const {
+
+    auto    fromIx = stopIndex(from);
+    auto    toIx = stopIndex(to);
+    Time    rv{};
+    bool    found = schedules_.at(day).findArriveTime(fromIx, leave, toIx, rv);
+    for (const auto& servicep: services_) {
+        Time    arrive{};
+        if (calendar.runs(servicep.first, day) && servicep.second.findArriveTime(fromIx, leave, toIx, arrive) &&
+            (!found || arrive < rv)) {
+
+            rv = arrive;
+            found = true;
+        }
+    }
+    if (!found) {
+        throw std::out_of_range{"no trip leaving at time in schedule"};
+    }
+    return rv;
+}
+
+ServiceTimes Route::getServiceStopTimes(const Stop& stop) const {
+    ServiceTimes    rv;
+    auto            stopIx = stopIndex(stop);
+    for (const auto& servicep: services_) {
+        for (auto time: servicep.second.getStopTimes(stopIx)) {
+            rv.emplace_back(time, servicep.first);
+        }
+    }
+    std::sort(rv.begin(), rv.end());
+    return rv;
+}
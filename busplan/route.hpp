@@ -9,16 +9,40 @@
 #include <map>
 #include <vector>
 
+#include "../utility/arena.hpp"
 #include "algorithm.hpp"
+#include "calendar.hpp"
 #include "day.hpp"
 #include "schedule.hpp"
 #include "stop.hpp"
 
 using Step = std::pair<Stop, Stop>;
 using Steps = std::vector<Step>;
+using TripStopTimes = std::vector<std::pair<Stop, Time>>;
 
 class Route {
 public:
+    //  On the heap, or on 'arena' with its schedules.
+    Route(): Route{nullptr} {
+    }
+    explicit Route(Utility::Arena* arena):
+        description_{}, stops_{}, platforms_{std::less<Stop>{}, Utility::ArenaAllocator<std::string>{arena}},
+        schedules_{}, services_{std::less<ServiceId>{}, Utility::ArenaAllocator<Schedule>{arena}} {
+
+        for (auto& schedule: schedules_) {
+            schedule = Schedule{arena};
+        }
+    }
+    //  Copy on 'arena'.
+    Route(const Route& other, Utility::Arena* arena): Route{arena} {
+        description_ = other.description_;
+        stops_ = other.stops_;
+        platforms_.insert(other.platforms_.cbegin(), other.platforms_.cend());
+        for (size_t day = 0; day < schedules_.size(); ++day) {
+            schedules_[day] = Schedule{other.schedules_[day], arena};
+        }
+        Utility::copyOnArena(other.services_, services_);
+    }
 
     const std::string& description() const {
         return description_;
@@ -30,16 +54,49 @@ public:
         assert(day < 7);
         return schedules_[day];
     }
+    const Schedule& schedule(Day day) const {
+        assert(day < 7);
+        return schedules_[day];
+    }
     const Stops& stops() const {
         return stops_;
     }
+    //  Trips running on the dates of a service of the calendar, whatever the weekday.
+    Schedule& serviceSchedule(ServiceId service) {
+        return Utility::emplaceOnArena(services_, service);
+    }
+    void compress() {
+        for (auto& schedule: schedules_) {
+            schedule.compress();
+        }
+        for (auto& servicep: services_) {
+            servicep.second.compress();
+        }
+    }
+    size_t memoryUsage() const {
+        size_t  rv = 0;
+        for (const auto& schedule: schedules_) {
+            rv += schedule.memoryUsage();
+        }
+        for (const auto& servicep: services_) {
+            rv += servicep.second.memoryUsage();
+        }
+        return rv;
+    }
+    template <typename Function>
+    void forEachService(Function function) const {
+        for (const auto& servicep: services_) {
+            function(servicep.first, servicep.second);
+        }
+    }
 
-    std::string getPlatform(const Stop& stop) const {
+    const std::string& getPlatform(const Stop& stop) const {
+        static const std::string    none;
         auto    it = platforms_.find(stop);
         if (it != platforms_.end()) {
             return it->second;
         }
-        return std::string{};
+        return none;
     }
 
     Steps getForwardSteps() const {
@@ -69,9 +126,33 @@ public:
         return schedules_[day].getStopTimes(stopIndex(stop));
     }
 
-    Time getArriveTime(Day day, const Stop& from, Time leave, const Stop& to) const {
+    //  Among the trips of the timetable of 'day', and of the services of 'calendar' running on
+    //  its date.
+    Time getArriveTime(Day day, const Stop& from, Time leave, const Stop& to, const ServiceCalendar& calendar) const;
+    //  Times at 'stop' of the trips of every service, with their service.
+    ServiceTimes getServiceStopTimes(const Stop& stop) const;
+
+    //  Stops 'fromIx' to 'toIx' of the trip leaving 'fromIx' the latest while reaching 'toIx' by
+    //  'arrive', with their times. Empty when there is none.
+    TripStopTimes getLatestTrip(Day day, size_t fromIx, size_t toIx, Time arrive) const {
         assert(day < 7);
-        return schedules_.at(day).getArriveTime(stopIndex(from), leave, stopIndex(to));
+        TripStopTimes   rv;
+        auto            tline = schedules_[day].getLatestTrip(fromIx, toIx, arrive);
+        for (size_t i = 0; i < tline.size(); ++i) {
+            rv.emplace_back(stops_[fromIx + i], tline[i]);
+        }
+        return rv;
+    }
+
+    TripStopTimes getTripTimes(Day day, Time start) const {
+        assert(day < 7);
+        TripStopTimes   rv;
+        size_t          fromIx = 0;
+        auto            tline = schedules_.at(day).getTripTimes(start, fromIx);
+        for (size_t i = 0; i < tline.size(); ++i) {
+            rv.emplace_back(stops_.at(fromIx + i), tline[i]);
+        }
+        return rv;
     }
 
 private:
@@ -85,10 +166,11 @@ private:
         return std::find(stops_.cbegin(), stops_.cend(), stop) - stops_.cbegin();
     }
 
-    std::string                 description_;
-    Stops                       stops_;
-    std::map<Stop, std::string> platforms_;
-    std::array<Schedule, 7>     schedules_;
+    std::string                             description_;
+    Stops                                   stops_;
+    Utility::ArenaMap<Stop, std::string>   platforms_;
+    std::array<Schedule, 7>                 schedules_;
+    Utility::ArenaMap<ServiceId, Schedule>  services_;
 };
 
 #endif // ROUTE_HPP
@@ -1,4 +1,5 @@
 #include <iterator>
+#include <stdexcept>
 
 #include "schedule.hpp"
 
@@ -20,17 +21,68 @@ TimeLine Schedule::getStopTimes(size_t stopIx) const {
 }
 
 Time Schedule::getArriveTime(size_t fromIx, Time leave, size_t toIx) const {
-    TimeLine    arrives;
+    Time    rv{};
+    if (!findArriveTime(fromIx, leave, toIx, rv)) {
+        throw std::out_of_range{"no trip leaving at time in schedule"};
+    }
+    return rv;
+}
+
+bool Schedule::findArriveTime(size_t fromIx, Time leave, size_t toIx, Time& arrive) const {
+    //  earliest arrival among the fragments, without collecting them: this runs for every leg of
+    //  every query.
+    bool    found = false;
     for (const auto& fragmentp: fragments_) {
         auto    startIx = getStopIndex(fragmentp.first);
         if (isStopInFragment(fragmentp.first, fromIx) && isStopInFragment(fragmentp.first, toIx)) {
             auto    arrive_result = fragmentp.second.findArriveTime(fromIx - startIx, leave, toIx - startIx);
-            if (arrive_result.second) {
-                arrives.push_back(arrive_result.first);
+            if (arrive_result.second && (!found || arrive_result.first < arrive)) {
+                arrive = arrive_result.first;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+TimeLine Schedule::getLatestTrip(size_t fromIx, size_t toIx, Time arrive) const {
+    const Fragment* best = nullptr;
+    size_t          bestIx = 0;
+    size_t          bestStartIx = 0;
+    for (const auto& fragmentp: fragments_) {
+        auto    startIx = getStopIndex(fragmentp.first);
+        if (isStopInFragment(fragmentp.first, fromIx) && isStopInFragment(fragmentp.first, toIx)) {
+            const auto& fragment = fragmentp.second;
+            auto        ix = fragment.findLatestTimeLine(fromIx - startIx, toIx - startIx, arrive);
+            if (ix == fragment.timeLinesCount()) {
+                continue;
             }
+            if (!best || fragment.getTime(ix, fromIx - startIx) > best->getTime(bestIx, fromIx - bestStartIx)) {
+                best = &fragment;
+                bestIx = ix;
+                bestStartIx = startIx;
+            }
+        }
+    }
+
+    TimeLine    rv;
+    if (best) {
+        for (auto stopIx = fromIx; stopIx <= toIx; ++stopIx) {
+            rv.push_back(best->getTime(bestIx, stopIx - bestStartIx));
+        }
+    }
+    return rv;
+}
+
+TimeLine Schedule::getTripTimes(Time start, size_t& fromIx) const {
+    for (const auto& fragmentp: fragments_) {
+        auto    tlinep = fragmentp.second.findTimeLine(start);
+        if (tlinep.second) {
+            fromIx = getStopIndex(fragmentp.first);
+            return tlinep.first;
         }
     }
-    return reduceTimeLine(arrives).front();
+    return TimeLine{};
 }
 
 
@@ -5,26 +5,75 @@
 #include <cassert>
 #include <map>
 
+#include "../utility/arena.hpp"
 #include "fragment.hpp"
 
 class Schedule {
 public:
+    //  On the heap, or on 'arena' with its fragments.
+    Schedule(): Schedule{nullptr} {
+    }
+    explicit Schedule(Utility::Arena* arena):
+        fragments_{std::less<FragmentIndex>{}, Utility::ArenaAllocator<Fragment>{arena}}, maxStopCount_{0} {
+    }
+    //  Copy on 'arena'.
+    Schedule(const Schedule& other, Utility::Arena* arena): Schedule{arena} {
+        Utility::copyOnArena(other.fragments_, fragments_);
+        maxStopCount_ = other.maxStopCount_;
+    }
+
     void setStopCount(size_t stopCount) {
         maxStopCount_ = stopCount;
     }
     void addTimeLine(size_t fromIx, const TimeLine& tline) {
         assert(tline.size() <= maxStopCount_);
 
-        fragments_[std::make_pair(fromIx, tline.size())].addTimeLine(tline);
+        auto&   fragment = Utility::emplaceOnArena(fragments_, std::make_pair(fromIx, tline.size()));
+        fragment.setStopCount(tline.size());
+        fragment.addTimeLine(tline);
+    }
+
+    //  See Fragment::compress().
+    void compress() {
+        for (auto& fragmentp: fragments_) {
+            fragmentp.second.compress();
+        }
+    }
+    //  Bytes used by the times.
+    size_t memoryUsage() const {
+        size_t  rv = 0;
+        for (const auto& fragmentp: fragments_) {
+            rv += fragmentp.second.memoryUsage();
+        }
+        return rv;
     }
 
     TimeLine getStopTimes(size_t stopIndex) const;
 
     Time getArriveTime(size_t fromIx, Time leave, size_t toIx) const;
+    //  Earliest arrival at 'toIx' of the trips leaving 'fromIx' at 'leave', into 'arrive'.
+    //  Returns false if there is none.
+    bool findArriveTime(size_t fromIx, Time leave, size_t toIx, Time& arrive) const;
+
+    //  Times from 'fromIx' to 'toIx' of the trip leaving 'fromIx' the latest among those
+    //  reaching 'toIx' by 'arrive'. Returns an empty time line when there is none.
+    TimeLine getLatestTrip(size_t fromIx, size_t toIx, Time arrive) const;
+
+    //  Time line of the trip leaving its first stop at 'start'. 'fromIx' receives the index of
+    //  that stop. Returns an empty time line when there is no such trip.
+    TimeLine getTripTimes(Time start, size_t& fromIx) const;
+
+    //  Call function(fromIx, fragment) for every fragment, by index of its first stop.
+    template <typename Function>
+    void forEachFragment(Function function) const {
+        for (const auto& fragmentp: fragments_) {
+            function(getStopIndex(fragmentp.first), fragmentp.second);
+        }
+    }
 
 private:
     using FragmentIndex = std::pair<size_t, size_t>;
-    using Fragments = std::map<FragmentIndex, Fragment>;
+    using Fragments = Utility::ArenaMap<FragmentIndex, Fragment>;
 
     static size_t getStopIndex(const FragmentIndex& fix) {
         return fix.first;
@@ -34,7 +83,7 @@ private:
     }
 
     static bool isStopInFragment(const FragmentIndex& fix, size_t stopIx) {
-        return getStopIndex(fix) >= stopIx && getStopIndex(fix) + getStopCount(fix) < stopIx;
+        return stopIx >= getStopIndex(fix) && stopIx < getStopIndex(fix) + getStopCount(fix);
     }
     Fragments   fragments_;
     size_t      maxStopCount_;
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "spatial_index.hpp"
+
+std::string toString(const Coordinates& position) {
+    char    buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%.6f,%.6f", position.latitude, position.longitude);
+    return buffer;
+}
+
+bool parseCoordinates(const std::string& str, Coordinates& position) {
+    auto    comma = str.find(',');
+    if (comma == str.npos || comma == 0 || comma + 1 == str.size()) {
+        return false;
+    }
+    char*   end = nullptr;
+    auto    latitude = std::strtod(str.c_str(), &end);
+    if (end != str.c_str() + comma) {
+        return false;
+    }
+    auto    longitude = std::strtod(str.c_str() + comma + 1, &end);
+    if (end != str.c_str() + str.size()) {
+        return false;
+    }
+    //  also rejects nan
+    if (!(latitude >= -90.0 && latitude <= 90.0 && longitude >= -180.0 && longitude <= 180.0)) {
+        return false;
+    }
+    position = Coordinates{latitude, longitude};
+    return true;
+}
+
+constexpr double SpatialIndex::metresPerDegree;
+
+SpatialIndex::SpatialIndex():
+    metresPerDegreeX_{metresPerDegree}, cellSize_{1.0}, pointCount_{0}, points_{}, cells_{} {
+}
+
+SpatialIndex::SpatialIndex(const std::vector<Coordinates>& points, double cellSize):
+    metresPerDegreeX_{metresPerDegree}, cellSize_{cellSize}, pointCount_{points.size()}, points_{}, cells_{} {
+
+    if (points.empty()) {
+        return;
+    }
+    double  latitude = 0.0;
+    for (const auto& point: points) {
+        latitude += point.latitude;
+    }
+    latitude /= points.size();
+    metresPerDegreeX_ = metresPerDegree * std::cos(latitude * std::acos(-1.0) / 180.0);
+
+    //  the points of a cell are contiguous.
+    std::vector<std::pair<CellKey, Point>>  keyed;
+    keyed.reserve(points.size());
+    for (size_t ix = 0; ix < points.size(); ++ix) {
+        auto    point = project(points[ix]);
+        point.index = ix;
+        keyed.emplace_back(cellKey(cell(point.x), cell(point.y)), point);
+    }
+    std::sort(keyed.begin(), keyed.end(), [](const std::pair<CellKey, Point>& a, const std::pair<CellKey, Point>& b) {
+        return a.first < b.first || (a.first == b.first && a.second.index < b.second.index);
+    });
+    points_.reserve(keyed.size());
+    for (const auto& entry: keyed) {
+        if (points_.empty() || keyed[points_.size() - 1].first != entry.first) {
+            cells_.emplace(entry.first, std::make_pair(points_.size(), points_.size()));
+        }
+        points_.push_back(entry.second);
+        ++cells_[entry.first].second;
+    }
+}
+
+void SpatialIndex::within(const Coordinates& position, double radius, Hits& hits) const {
+    hits.clear();
+    forEachWithin(position, radius, [&hits](size_t point, double distance) {
+        hits.push_back(Hit{point, distance});
+    });
+    std::sort(hits.begin(), hits.end(), [](const Hit& a, const Hit& b) {
+        return a.distance < b.distance || (a.distance == b.distance && a.point < b.point);
+    });
+}
+
+void SpatialIndex::nearest(const Coordinates& position, size_t k, double radius, Hits& hits) const {
+    within(position, radius, hits);
+    if (hits.size() > k) {
+        hits.resize(k);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef SPATIAL_INDEX_HPP
+#define SPATIAL_INDEX_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//  Position on the earth, in degrees.
+struct Coordinates {
+    double  latitude;
+    double  longitude;
+};
+
+//  "latitude,longitude", in degrees with six decimals.
+std::string toString(const Coordinates& position);
+//  Parse "latitude,longitude" into 'position', false if 'str' is not a position: both numbers
+//  whole, in range.
+bool parseCoordinates(const std::string& str, Coordinates& position);
+
+//  Points on a uniform grid of square cells, to find the ones near a position in time
+//  proportional to their number. Positions are projected on a plane at the mean latitude of
+//  the points, which is accurate to a few metres over a city or a region; distances are in
+//  metres on that plane.
+class SpatialIndex {
+public:
+    //  A point of the index, by its position in the constructor, and its distance to a query.
+    struct Hit {
+        size_t  point;
+        double  distance;
+    };
+    using Hits = std::vector<Hit>;
+
+    SpatialIndex();
+    SpatialIndex(const std::vector<Coordinates>& points, double cellSize);
+
+    size_t size() const {
+        return pointCount_;
+    }
+    //  The points within 'radius' of 'position', nearest first.
+    void within(const Coordinates& position, double radius, Hits& hits) const;
+    //  The 'k' nearest points within 'radius' of 'position', nearest first.
+    void nearest(const Coordinates& position, size_t k, double radius, Hits& hits) const;
+    //  Call 'function'(point, distance) for every point within 'radius' of 'position', in no
+    //  particular order.
+    template <typename Function>
+    void forEachWithin(const Coordinates& position, double radius, Function function) const;
+
+private:
+    struct Point {
+        double  x;
+        double  y;
+        size_t  index;
+    };
+    using CellKey = std::uint64_t;
+
+    Point project(const Coordinates& position) const {
+        return Point{position.longitude * metresPerDegreeX_, position.latitude * metresPerDegree, 0};
+    }
+    std::int64_t cell(double metres) const {
+        return static_cast<std::int64_t>(std::floor(metres / cellSize_));
+    }
+    static CellKey cellKey(std::int64_t cx, std::int64_t cy) {
+        return (static_cast<CellKey>(static_cast<std::uint32_t>(cx)) << 32) | static_cast<std::uint32_t>(cy);
+    }
+
+    static constexpr double metresPerDegree = 111320.0;
+
+    double                                                  metresPerDegreeX_;  //  of longitude
+    double                                                  cellSize_;
+    size_t                                                  pointCount_;
+    std::vector<Point>                                      points_;            //  by cell
+    std::unordered_map<CellKey, std::pair<size_t, size_t>>  cells_;             //  range of points_
+};
+
+template <typename Function>
+void SpatialIndex::forEachWithin(const Coordinates& position, double radius, Function function) const {
+    if (points_.empty()) {
+        return;
+    }
+    auto    centre = project(position);
+    for (auto cx = cell(centre.x - radius); cx <= cell(centre.x + radius); ++cx) {
+        for (auto cy = cell(centre.y - radius); cy <= cell(centre.y + radius); ++cy) {
+            auto    it = cells_.find(cellKey(cx, cy));
+            if (it == cells_.cend()) {
+                continue;
+            }
+            for (auto ix = it->second.first; ix < it->second.second; ++ix) {
+                const auto& point = points_[ix];
+                auto        distance = std::hypot(point.x - centre.x, point.y - centre.y);
+                if (distance <= radius) {
+                    function(point.index, distance);
+                }
+            }
+        }
+    }
+}
+
+#endif // SPATIAL_INDEX_HPP
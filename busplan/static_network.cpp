@@ -0,0 +1,92 @@
+#include <memory>
+
+#include "static_network.hpp"
+#include "time_line.hpp"
+
+void read(const StaticNetwork& network, Lines& lines, StopDescriptions& sds, StopGroups& groups) {
+    lines = network.arenaBuffer ?
+        Lines{std::make_shared<Utility::Arena>(network.arenaBuffer, network.arenaSize)} : Lines{};
+
+    auto    stop_name = [&network](std::uint32_t stopIx) {
+        return Stop{network.stops[stopIx].name};
+    };
+    for (std::uint32_t stopIx = 0; stopIx < network.stops.size; ++stopIx) {
+        const auto& sstop = network.stops[stopIx];
+        if (sstop.described) {
+            auto&   descriptions = sds[sstop.name];
+            for (auto ix = sstop.descriptions.first; ix < sstop.descriptions.first + sstop.descriptions.size; ++ix) {
+                descriptions.push_back(network.strings[ix]);
+            }
+        }
+    }
+    for (std::uint32_t serviceIx = 0; serviceIx < network.services.size; ++serviceIx) {
+        const auto&                 sservice = network.services[serviceIx];
+        ServiceCalendar::Service    service{sservice.name, sservice.first, sservice.last, sservice.weekdays, {}, {}};
+        for (auto ix = sservice.exceptions.first; ix < sservice.exceptions.first + sservice.exceptions.size; ++ix) {
+            const auto& exception = network.exceptions[ix];
+            (exception.added ? service.added : service.removed).push_back(exception.date);
+        }
+        lines.calendar().add(std::move(service));
+    }
+    lines.calendar().compile();
+
+    for (std::uint32_t lineIx = 0; lineIx < network.lines.size; ++lineIx) {
+        const auto& sline = network.lines[lineIx];
+        auto&       line = lines.addLine(sline.name);
+        for (auto routeIx = sline.routes.first; routeIx < sline.routes.first + sline.routes.size; ++routeIx) {
+            const auto& sroute = network.routes[routeIx];
+            auto&       route = line.addRoute(sroute.name);
+            route.setDescription(sroute.description);
+            for (auto ix = sroute.stops.first; ix < sroute.stops.first + sroute.stops.size; ++ix) {
+                route.addStop(stop_name(network.routeStops[ix]));
+            }
+            for (auto ix = sroute.platforms.first; ix < sroute.platforms.first + sroute.platforms.size; ++ix) {
+                const auto& platform = network.platforms[ix];
+                route.addPlatform(stop_name(platform.stop), platform.platform);
+            }
+            for (auto day: week) {
+                route.schedule(day).setStopCount(sroute.stops.size);
+            }
+            for (auto ix = sroute.schedules.first; ix < sroute.schedules.first + sroute.schedules.size; ++ix) {
+                const auto& sschedule = network.schedules[ix];
+                auto&       schedule = sschedule.service == weekdayService ?
+                    route.schedule(Day{size_t{sschedule.day}}) : route.serviceSchedule(sschedule.service);
+                schedule.setStopCount(sroute.stops.size);
+                for (auto fix = sschedule.fragments.first; fix < sschedule.fragments.first + sschedule.fragments.size; ++fix) {
+                    const auto& fragment = network.fragments[fix];
+                    TimeLine    tline(fragment.stops);
+                    for (std::uint32_t trip = 0; trip < fragment.trips; ++trip) {
+                        auto    times = &network.times[fragment.firstTime + trip * fragment.stops];
+                        for (std::uint32_t stopIx = 0; stopIx < fragment.stops; ++stopIx) {
+                            tline[stopIx] = Time{DifTime{times[stopIx]}};
+                        }
+                        schedule.addTimeLine(fragment.from, tline);
+                    }
+                }
+            }
+        }
+    }
+
+    for (std::uint32_t stopIx = 0; stopIx < network.stops.size; ++stopIx) {
+        const auto& sstop = network.stops[stopIx];
+        if (sstop.located) {
+            lines.stopCoordinates().emplace(sstop.name, Coordinates{sstop.latitude, sstop.longitude});
+        }
+    }
+    for (std::uint32_t walkIx = 0; walkIx < network.walks.size; ++walkIx) {
+        const auto& walk = network.walks[walkIx];
+        lines.walkingTimes().emplace(
+            WalkingStep{stop_name(walk.from), stop_name(walk.to)}, DifTime{walk.minutes});
+    }
+    for (std::uint32_t groupIx = 0; groupIx < network.groups.size; ++groupIx) {
+        const auto& sgroup = network.groups[groupIx];
+        auto&       stops = groups[sgroup.name];
+        for (auto ix = sgroup.stops.first; ix < sgroup.stops.first + sgroup.stops.size; ++ix) {
+            stops.push_back(stop_name(network.groupStops[ix]));
+        }
+    }
+
+    if (network.compressed) {
+        lines.compress();
+    }
+}
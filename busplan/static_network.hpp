@@ -0,0 +1,127 @@
+#pragma once
+#ifndef STATIC_NETWORK_HPP
+#define STATIC_NETWORK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "calendar.hpp"
+#include "day.hpp"
+#include "lines.hpp"
+#include "stop.hpp"
+
+//  A network compiled into the binary by netcode: constant tables of the model as loaded from
+//  its configuration, with the timetables expanded and the walks generated, so that it is built
+//  without reading nor parsing anything. Entries refer to those of other tables by index, and
+//  to a run of them by its first index and size.
+
+template <typename T>
+struct StaticTable {
+    const T*        entries;
+    std::uint32_t   size;
+
+    const T& operator[](size_t ix) const {
+        return entries[ix];
+    }
+};
+
+struct StaticRange {
+    std::uint32_t   first;
+    std::uint32_t   size;
+};
+
+struct StaticStop {
+    const char*     name;
+    bool            described;      //  in [stops], with 'descriptions'
+    StaticRange     descriptions;
+    bool            located;        //  with 'latitude' and 'longitude'
+    double          latitude;
+    double          longitude;
+};
+
+struct StaticService {
+    const char*     name;
+    Date            first;
+    Date            last;
+    std::uint8_t    weekdays;
+    StaticRange     exceptions;
+};
+
+struct StaticException {
+    Date    date;
+    bool    added;
+};
+
+struct StaticLine {
+    const char*     name;
+    StaticRange     routes;
+};
+
+struct StaticRoute {
+    const char*     name;
+    const char*     description;
+    StaticRange     stops;          //  of routeStops
+    StaticRange     platforms;
+    StaticRange     schedules;
+};
+
+struct StaticPlatform {
+    std::uint32_t   stop;
+    const char*     platform;
+};
+
+//  The timetable of a weekday for weekdayService, else the one of the service.
+struct StaticSchedule {
+    ServiceId       service;
+    std::uint8_t    day;
+    StaticRange     fragments;
+};
+
+//  'trips' time lines of 'stops' times from the stop 'from' of the route, in minutes.
+struct StaticFragment {
+    std::uint32_t   from;
+    std::uint32_t   stops;
+    std::uint32_t   trips;
+    std::uint32_t   firstTime;
+};
+
+struct StaticWalk {
+    std::uint32_t   from;
+    std::uint32_t   to;
+    std::int32_t    minutes;
+};
+
+struct StaticGroup {
+    const char*     name;
+    StaticRange     stops;          //  of groupStops
+};
+
+struct StaticNetwork {
+    StaticTable<const char*>        strings;
+    StaticTable<StaticStop>         stops;
+    StaticTable<StaticService>      services;
+    StaticTable<StaticException>    exceptions;
+    StaticTable<StaticLine>         lines;
+    StaticTable<StaticRoute>        routes;
+    StaticTable<std::uint32_t>      routeStops;
+    StaticTable<StaticPlatform>     platforms;
+    StaticTable<StaticSchedule>     schedules;
+    StaticTable<StaticFragment>     fragments;
+    StaticTable<std::int32_t>       times;
+    StaticTable<StaticWalk>         walks;
+    StaticTable<StaticGroup>        groups;
+    StaticTable<std::uint32_t>      groupStops;
+    double                          walkingSpeed;   //  see walkingSpeed()
+    bool                            compressed;     //  see Lines::compress()
+    //  Where the model is built, sized for it, or nullptr for the heap.
+    char*                           arenaBuffer;
+    size_t                          arenaSize;
+};
+
+//  Build the model of 'network' into 'lines', which take an arena on its buffer.
+void read(const StaticNetwork& network, Lines& lines, StopDescriptions& sds, StopGroups& groups);
+
+//  The network linked into the binary, defined by the source generated by netcode.
+const StaticNetwork& staticNetwork();
+
+#endif // STATIC_NETWORK_HPP
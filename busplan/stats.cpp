@@ -0,0 +1,96 @@
+#include <atomic>
+#include <iomanip>
+
+#include "stats.hpp"
+
+namespace {
+
+//  Off unless statistics are asked for: a counted allocation then costs a test of the flag.
+std::atomic<bool>           counting{false};
+thread_local unsigned long  allocations = 0;
+
+const char* const   phaseNames[phaseCount] = {
+    "weights", "search", "reconstruction", "details", "output"
+};
+const char* const   counterNames[counterCount] = {
+    "vertices-settled", "edges-relaxed", "lower-bounds", "edges-pruned", "allocations"
+};
+
+std::ostream& writeSummary(std::ostream& os, const char* name, const char* unit, const Utility::Histogram& h) {
+    os << std::left << std::setw(18) << name << std::right << std::setw(4) << unit;
+    os << std::setw(10) << h.count() << std::setw(12) << static_cast<unsigned long>(h.mean());
+    os << std::setw(10) << h.percentile(50) << std::setw(10) << h.percentile(90);
+    os << std::setw(10) << h.percentile(99) << std::setw(10) << h.percentile(99.9);
+    os << std::setw(10) << h.max() << std::endl;
+    return os;
+}
+
+}
+
+void countAllocations(bool count) {
+    counting.store(count, std::memory_order_relaxed);
+}
+
+unsigned long allocationCount() {
+    return allocations;
+}
+
+void countAllocation() {
+    if (counting.load(std::memory_order_relaxed)) {
+        ++allocations;
+    }
+}
+
+const char* toString(Phase phase) {
+    return phaseNames[static_cast<size_t>(phase)];
+}
+
+const char* toString(Counter counter) {
+    return counterNames[static_cast<size_t>(counter)];
+}
+
+QueryStats::Duration QueryStats::total() const {
+    Duration    rv{0};
+    for (auto d: phases_) {
+        rv += d;
+    }
+    return rv;
+}
+
+std::ostream& operator<<(std::ostream& os, const QueryStats& stats) {
+    for (size_t i = 0; i < phaseCount; ++i) {
+        auto    phase = static_cast<Phase>(i);
+        os << std::left << std::setw(18) << toString(phase) << std::right;
+        os << std::setw(12) << stats.phase(phase).count() / 1000.0 << " us" << std::endl;
+    }
+    for (size_t i = 0; i < counterCount; ++i) {
+        auto    counter = static_cast<Counter>(i);
+        os << std::left << std::setw(18) << toString(counter) << std::right;
+        os << std::setw(12) << stats.counter(counter) << std::endl;
+    }
+    return os;
+}
+
+void StatsHistograms::record(const QueryStats& stats) {
+    for (size_t i = 0; i < phaseCount; ++i) {
+        phases_[i].record(stats.phase(static_cast<Phase>(i)).count() / 1000);
+    }
+    for (size_t i = 0; i < counterCount; ++i) {
+        counters_[i].record(stats.counter(static_cast<Counter>(i)));
+    }
+    total_.record(stats.total().count() / 1000);
+}
+
+std::ostream& StatsHistograms::write(std::ostream& os) const {
+    os << std::left << std::setw(22) << "" << std::right << std::setw(10) << "count" << std::setw(12) << "mean";
+    os << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99";
+    os << std::setw(10) << "p99.9" << std::setw(10) << "max" << std::endl;
+    for (size_t i = 0; i < phaseCount; ++i) {
+        writeSummary(os, phaseNames[i], "us", phases_[i]);
+    }
+    writeSummary(os, "total", "us", total_);
+    for (size_t i = 0; i < counterCount; ++i) {
+        writeSummary(os, counterNames[i], "", counters_[i]);
+    }
+    return os;
+}
@@ -0,0 +1,140 @@
+#pragma once
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <array>
+#include <chrono>
+#include <ostream>
+
+#include "../utility/histogram.hpp"
+
+//  Per query instrumentation. Code on the query path takes a 'QueryStats*' which is null
+//  when statistics are disabled, so the cost is a test of a pointer.
+
+enum class Phase {
+    weights,
+    search,
+    reconstruction,
+    details,
+    output
+};
+const size_t    phaseCount = 5;
+
+enum class Counter {
+    verticesSettled,
+    edgesRelaxed,
+    lowerBounds,
+    edgesPruned,
+    allocations
+};
+const size_t    counterCount = 5;
+
+const char* toString(Phase phase);
+const char* toString(Counter counter);
+
+class QueryStats {
+public:
+    using Duration = std::chrono::nanoseconds;
+
+    QueryStats() {
+        clear();
+    }
+
+    void add(Phase phase, Duration duration) {
+        phases_[static_cast<size_t>(phase)] += duration;
+    }
+    void count(Counter counter, unsigned long n = 1) {
+        counters_[static_cast<size_t>(counter)] += n;
+    }
+    Duration phase(Phase phase) const {
+        return phases_[static_cast<size_t>(phase)];
+    }
+    unsigned long counter(Counter counter) const {
+        return counters_[static_cast<size_t>(counter)];
+    }
+    Duration total() const;
+    void clear() {
+        phases_.fill(Duration{0});
+        counters_.fill(0);
+    }
+
+private:
+    std::array<Duration, phaseCount>        phases_;
+    std::array<unsigned long, counterCount> counters_;
+};
+
+std::ostream& operator<<(std::ostream& os, const QueryStats& stats);
+
+//  Aggregate of the statistics of many queries, for batch runs.
+class StatsHistograms {
+public:
+    void record(const QueryStats& stats);
+    std::ostream& write(std::ostream& os) const;
+
+private:
+    std::array<Utility::Histogram, phaseCount>      phases_;
+    std::array<Utility::Histogram, counterCount>    counters_;
+    Utility::Histogram                              total_;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const StatsHistograms& histograms) {
+    return histograms.write(os);
+}
+
+//  Adds the time spent in its scope, or until stop(), to a phase.
+class ScopedTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ScopedTimer(QueryStats* stats, Phase phase): stats_{stats}, phase_{phase}, start_{} {
+        if (stats_) {
+            start_ = Clock::now();
+        }
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+    ~ScopedTimer() {
+        stop();
+    }
+
+    void stop() {
+        if (stats_) {
+            stats_->add(phase_, std::chrono::duration_cast<QueryStats::Duration>(Clock::now() - start_));
+            stats_ = nullptr;
+        }
+    }
+
+private:
+    QueryStats*         stats_;
+    Phase               phase_;
+    Clock::time_point   start_;
+};
+
+//  Count the operator new calls of every thread from now on, or stop counting. Off by default.
+//  Only the binaries built with allocations.cpp, which replaces operator new, count them: the
+//  other ones always count none.
+void countAllocations(bool count);
+//  Number of operator new calls made by the calling thread while counting.
+unsigned long allocationCount();
+//  An operator new call of the calling thread.
+void countAllocation();
+
+//  Counts the allocations made by the calling thread in its scope.
+class ScopedAllocationCounter {
+public:
+    explicit ScopedAllocationCounter(QueryStats* stats): stats_{stats}, start_{stats ? allocationCount() : 0} {
+    }
+    ScopedAllocationCounter(const ScopedAllocationCounter&) = delete;
+    ScopedAllocationCounter& operator=(const ScopedAllocationCounter&) = delete;
+    ~ScopedAllocationCounter() {
+        if (stats_) {
+            stats_->count(Counter::allocations, allocationCount() - start_);
+        }
+    }
+
+private:
+    QueryStats*     stats_;
+    unsigned long   start_;
+};
+
+#endif // STATS_HPP
@@ -12,5 +12,7 @@ using Stops = std::vector<Stop>;
 using StopSet = std::set<Stop>;
 using StopDescriptions = std::map<Stop, std::vector<std::string>>;
 using StopDescription = StopDescriptions::value_type;
+//  Stops any of which will do as origin or destination, by name.
+using StopGroups = std::map<std::string, Stops>;
 
 #endif // STOP_HPP
@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+
+#include "../utility/binary_io.hpp"
+#include "transfer_patterns.hpp"
+
+using Utility::read32;
+using Utility::read64;
+using Utility::write32;
+using Utility::write64;
+
+namespace {
+
+const std::uint64_t magic = 0x32727074; //  "tpr2", with the walking patterns
+
+}
+
+TransferPatterns::TransferPatterns(const Lines& lines, unsigned threads):
+    tables_{}, nodeOffsets_{0}, nodes_{}, originOffsets_{}, origins_{} {
+
+    //  days with the same timetable have the same patterns, search them once
+    std::vector<std::uint64_t>              fingerprints;
+    std::vector<std::unique_ptr<TripBased>> engines;
+    std::vector<const TripBased*>           distinctDays;
+    for (auto day: week) {
+        tables_[day] = TripTable{lines, day, true};
+        auto    fingerprint = tables_[day].fingerprint();
+        if (std::find(fingerprints.cbegin(), fingerprints.cend(), fingerprint) == fingerprints.cend()) {
+            fingerprints.push_back(fingerprint);
+            engines.emplace_back(new TripBased{lines, day, threads});
+            distinctDays.push_back(engines.back().get());
+        }
+    }
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    auto                            stopCount = tables_[0].stopCount();
+    std::vector<std::vector<Node>>  trees(stopCount);
+    std::atomic<size_t>             next{0};
+    std::vector<std::thread>        workers;
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([this, stopCount, &next, &distinctDays, &trees]() {
+            for (size_t destination = next++; destination < stopCount; destination = next++) {
+                computePatterns(static_cast<StopIndex>(destination), distinctDays, trees[destination]);
+            }
+        });
+    }
+    for (auto& worker: workers) {
+        worker.join();
+    }
+
+    for (auto& tree: trees) {
+        nodes_.insert(nodes_.end(), tree.cbegin(), tree.cend());
+        nodeOffsets_.push_back(nodes_.size());
+        std::vector<Node>{}.swap(tree);
+    }
+    indexOrigins();
+}
+
+TransferPatterns::TransferPatterns(const Lines& lines, std::istream& is):
+    tables_{}, nodeOffsets_{0}, nodes_{}, originOffsets_{}, origins_{} {
+
+    if (read64(is) != magic) {
+        throw std::runtime_error("Not transfer patterns data");
+    }
+    for (auto day: week) {
+        tables_[day] = TripTable{lines, day, true};
+        if (read64(is) != tables_[day].fingerprint()) {
+            throw std::runtime_error("Transfer patterns are stale, the timetable has changed");
+        }
+    }
+    auto    stopCount = tables_[0].stopCount();
+    if (read64(is) != stopCount) {
+        throw std::runtime_error("Transfer patterns are stale, the timetable has changed");
+    }
+    auto    nodeCount = read64(is);
+    for (size_t destination = 0; destination < stopCount; ++destination) {
+        nodeOffsets_.push_back(nodeOffsets_.back() + read32(is));
+    }
+    if (nodeOffsets_.back() != nodeCount) {
+        throw std::runtime_error("Corrupt transfer patterns data");
+    }
+    nodes_.reserve(nodeCount);
+    for (size_t destination = 0; destination < stopCount; ++destination) {
+        auto    count = nodeOffsets_[destination + 1] - nodeOffsets_[destination];
+        for (size_t n = 0; n < count; ++n) {
+            Node    node;
+            node.stop = read32(is);
+            node.parent = read32(is);
+            auto    flags = read32(is);
+            node.walk = (flags & 1) != 0;
+            node.origin = (flags & 2) != 0;
+            if (node.stop >= stopCount || (node.parent != noParent && node.parent >= n)) {
+                throw std::runtime_error("Corrupt transfer patterns data");
+            }
+            nodes_.push_back(node);
+        }
+    }
+    indexOrigins();
+}
+
+void TransferPatterns::write(std::ostream& os) const {
+    write64(os, magic);
+    for (auto day: week) {
+        write64(os, tables_[day].fingerprint());
+    }
+    write64(os, tables_[0].stopCount());
+    write64(os, nodes_.size());
+    for (size_t destination = 0; destination + 1 < nodeOffsets_.size(); ++destination) {
+        write32(os, static_cast<std::uint32_t>(nodeOffsets_[destination + 1] - nodeOffsets_[destination]));
+    }
+    for (const auto& node: nodes_) {
+        write32(os, node.stop);
+        write32(os, node.parent);
+        write32(os, (node.walk ? 1 : 0) | (node.origin ? 2 : 0));
+    }
+}
+
+size_t TransferPatterns::memoryUsage() const {
+    size_t  rv = 0;
+    for (const auto& table: tables_) {
+        rv += table.memoryUsage();
+    }
+    rv += nodeOffsets_.capacity() * sizeof(size_t) + nodes_.capacity() * sizeof(Node);
+    rv += originOffsets_.capacity() * sizeof(size_t) + origins_.capacity() * sizeof(origins_[0]);
+    return rv;
+}
+
+//  The patterns of the optimal journeys to 'destination' arriving at each time a bus can bring
+//  there: the optimal journey of any other arrival time arrives at one of them.
+void TransferPatterns::computePatterns(
+    StopIndex destination, const std::vector<const TripBased*>& engines, std::vector<Node>& nodes) const {
+
+    using Pattern = TripBased::TransferStops;
+
+    std::set<Pattern>       patterns;
+    std::vector<Time>       arrivals;
+    std::vector<Pattern>    transferStops;
+    for (auto engine: engines) {
+        const auto& table = engine->table();
+        auto        add_arrivals = [&table, &arrivals](StopIndex stopIx, DifTime walk) {
+            for (const auto& stopPosition: table.stopPositions(stopIx)) {
+                const auto& pattern = table.pattern(stopPosition.pattern);
+                if (stopPosition.position + 1 >= pattern.stopCount) {
+                    continue;
+                }
+                for (auto trip = pattern.firstTrip; trip < pattern.firstTrip + pattern.tripCount; ++trip) {
+                    arrivals.push_back(table.originalTime(trip, stopPosition.position) + walk);
+                }
+            }
+        };
+
+        //  walking there is a journey at any time, not only at the arrivals of the buses.
+        arrivals.clear();
+        add_arrivals(destination, DifTime{0});
+        for (const auto& footpath: table.footpaths(destination)) {
+            add_arrivals(footpath.stop, footpath.duration);
+            patterns.insert(Pattern{{footpath.stop, true}, {destination, false}});
+        }
+        std::sort(arrivals.begin(), arrivals.end());
+        arrivals.erase(std::unique(arrivals.begin(), arrivals.end()), arrivals.end());
+
+        for (auto arrive: arrivals) {
+            engine->transferStopsFromArrive(destination, arrive, transferStops);
+            for (const auto& pattern: transferStops) {
+                if (!pattern.empty()) {
+                    patterns.insert(pattern);
+                }
+            }
+        }
+    }
+
+    std::map<std::tuple<std::uint32_t, StopIndex, bool>, std::uint32_t> children;
+    nodes.assign(1, Node{destination, noParent, false, false});
+    for (const auto& pattern: patterns) {
+        std::uint32_t   node = 0;
+        for (auto i = pattern.size() - 1; i-- > 0;) {
+            auto    key = std::make_tuple(node, pattern[i].first, pattern[i].second);
+            auto    it = children.find(key);
+            if (it == children.end()) {
+                it = children.emplace(key, static_cast<std::uint32_t>(nodes.size())).first;
+                nodes.push_back(Node{pattern[i].first, node, pattern[i].second, false});
+            }
+            node = it->second;
+        }
+        nodes[node].origin = true;
+    }
+}
+
+void TransferPatterns::indexOrigins() {
+    originOffsets_.assign(1, 0);
+    origins_.clear();
+    for (size_t destination = 0; destination + 1 < nodeOffsets_.size(); ++destination) {
+        auto    first = origins_.size();
+        for (auto n = nodeOffsets_[destination]; n < nodeOffsets_[destination + 1]; ++n) {
+            if (nodes_[n].origin) {
+                origins_.emplace_back(nodes_[n].stop, static_cast<std::uint32_t>(n - nodeOffsets_[destination]));
+            }
+        }
+        std::sort(origins_.begin() + first, origins_.end());
+        originOffsets_.push_back(origins_.size());
+    }
+}
+
+bool TransferPatterns::latestConnection(
+    const TripTable& table, StopIndex from, StopIndex to, Time arrive, Connection& connection,
+    QueryStats* stats) const {
+
+    //  on the reversed table 'to' comes before 'from'
+    auto    start = Time{-arrive.time_since_epoch()};
+    auto    found = false;
+    for (const auto& toPosition: table.stopPositions(to)) {
+        for (const auto& fromPosition: table.stopPositions(from)) {
+            if (fromPosition.pattern != toPosition.pattern || fromPosition.position <= toPosition.position) {
+                continue;
+            }
+            if (stats) {
+                stats->count(Counter::lowerBounds);
+            }
+            auto    trip = table.earliestTrip(toPosition.pattern, toPosition.position, start);
+            if (trip == table.tripCount()) {
+                continue;
+            }
+            if (!found || table.time(trip, fromPosition.position) < table.time(connection.trip, connection.from)) {
+                connection = Connection{trip, fromPosition.position, toPosition.position};
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+bool TransferPatterns::planFromArrive(
+    Day day, const Stop& from, const Stop& to, Time arrive, Journey& journey, QueryStats* stats) const {
+
+    const auto& table = tables_[day];
+    StopIndex   origin, destination;
+    if (!table.findStop(from, origin)) {
+        throw std::out_of_range(std::string{"Unknown stop "}.append(from));
+    }
+    if (!table.findStop(to, destination)) {
+        throw std::out_of_range(std::string{"Unknown stop "}.append(to));
+    }
+    journey.clear();
+    if (origin == destination) {
+        return false;
+    }
+
+    struct Leg {
+        std::uint32_t   node;
+        Time            leave;
+        Connection      connection;
+    };
+
+    //  every pattern is evaluated from the destination backwards, taking on each leg the
+    //  latest connection that leaves time enough to change to the next one.
+    ScopedTimer     searchTimer{stats, Phase::search};
+    const auto*     nodes = nodes_.data() + nodeOffsets_[destination];
+    auto            origins = std::equal_range(
+        origins_.cbegin() + originOffsets_[destination],
+        origins_.cbegin() + originOffsets_[destination + 1],
+        std::make_pair(origin, std::uint32_t{0}),
+        [](const std::pair<StopIndex, std::uint32_t>& a, const std::pair<StopIndex, std::uint32_t>& b) {
+            return a.first < b.first;
+        });
+    std::vector<std::uint32_t>  path;
+    std::vector<Leg>            legs, bestLegs;
+    Time                        best = minusInf;
+    for (auto it = origins.first; it != origins.second; ++it) {
+        if (stats) {
+            stats->count(Counter::verticesSettled);
+        }
+        path.clear();
+        for (auto n = it->second; n != noParent; n = nodes[n].parent) {
+            path.push_back(n);
+        }
+        legs.clear();
+        auto    leave = arrive;
+        auto    valid = true;
+        for (auto i = path.size() - 1; valid && i-- > 0;) {
+            const auto& node = nodes[path[i]];
+            const auto& parent = nodes[node.parent];
+            auto        arriveBy = parent.parent == noParent || parent.walk ? leave : leave - transferTime;
+            Leg         leg{path[i], arriveBy, Connection{0, 0, 0}};
+            if (node.walk) {
+                leg.leave = arriveBy - table.walkingTime(node.stop, parent.stop);
+            } else if (latestConnection(table, node.stop, parent.stop, arriveBy, leg.connection, stats)) {
+                leg.leave = table.originalTime(leg.connection.trip, leg.connection.from);
+            } else {
+                valid = false;
+            }
+            leave = leg.leave;
+            legs.push_back(leg);
+        }
+        if (valid && leave > best) {
+            best = leave;
+            bestLegs.swap(legs);
+        }
+    }
+    searchTimer.stop();
+    if (bestLegs.empty()) {
+        return false;
+    }
+
+    ScopedTimer reconstructionTimer{stats, Phase::reconstruction};
+    for (auto it = bestLegs.crbegin(); it != bestLegs.crend(); ++it) {
+        const auto& node = nodes[it->node];
+        const auto& parent = nodes[node.parent];
+        if (node.walk) {
+            auto    arrival = it->leave + table.walkingTime(node.stop, parent.stop);
+            journey.push_back(JourneyLeg{
+                walkingRouteId, {{table.stop(node.stop), it->leave}, {table.stop(parent.stop), arrival}}});
+            continue;
+        }
+        const auto& connection = it->connection;
+        auto        patternIx = table.tripPattern(connection.trip);
+        JourneyLeg  leg{table.pattern(patternIx).routeid, {}};
+        for (auto pos = connection.from + 1; pos-- > connection.to;) {
+            leg.stops.emplace_back(table.stop(table.patternStop(patternIx, pos)), table.originalTime(connection.trip, pos));
+        }
+        journey.push_back(std::move(leg));
+    }
+    return true;
+}
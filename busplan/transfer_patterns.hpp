@@ -0,0 +1,76 @@
+#pragma once
+#ifndef TRANSFER_PATTERNS_HPP
+#define TRANSFER_PATTERNS_HPP
+
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "algorithm.hpp"
+#include "day.hpp"
+#include "journey.hpp"
+#include "lines.hpp"
+#include "stats.hpp"
+#include "trip_based.hpp"
+#include "trip_table.hpp"
+
+//  Transfer patterns (Bast et al., 2010).
+//
+//  For every destination, the stop sequences where optimal journeys to it change vehicle (or
+//  start or stop walking), over every day and arrival time. They are merged in a tree rooted at
+//  the destination, whose nodes point towards it, so shared endings are stored once. A query
+//  only follows the patterns starting at its origin, with direct connection lookups on the
+//  timetable of the day.
+class TransferPatterns {
+public:
+    static const std::uint32_t  noParent = static_cast<std::uint32_t>(-1);
+
+    struct Node {
+        StopIndex       stop;
+        std::uint32_t   parent;     //  next node towards the destination, noParent for the root
+        bool            walk;       //  the leg to the parent is walked
+        bool            origin;     //  a pattern starts here
+    };
+
+    //  Compute the patterns with the trip based engine, one destination per thread at a time.
+    TransferPatterns(const Lines& lines, unsigned threads = 0);
+    //  Read the patterns written by write(). Throws std::runtime_error if they were computed for
+    //  another timetable.
+    TransferPatterns(const Lines& lines, std::istream& is);
+
+    void write(std::ostream& os) const;
+
+    size_t nodeCount() const {
+        return nodes_.size();
+    }
+    //  Bytes used by the patterns and the timetables.
+    size_t memoryUsage() const;
+
+    bool planFromArrive(
+        Day day, const Stop& from, const Stop& to, Time arrive, Journey& journey, QueryStats* stats = nullptr) const;
+
+private:
+    struct Connection {
+        TripIndex       trip;
+        std::uint32_t   from;
+        std::uint32_t   to;
+    };
+
+    void computePatterns(
+        StopIndex destination, const std::vector<const TripBased*>& engines, std::vector<Node>& nodes) const;
+    void indexOrigins();
+    //  Latest trip from 'from' reaching 'to' by 'arrive' without changing, on the reversed table.
+    bool latestConnection(
+        const TripTable& table, StopIndex from, StopIndex to, Time arrive, Connection& connection,
+        QueryStats* stats) const;
+
+    std::array<TripTable, 7>                            tables_;
+    std::vector<size_t>                                 nodeOffsets_;       //  per destination
+    std::vector<Node>                                   nodes_;
+    std::vector<size_t>                                 originOffsets_;     //  per destination
+    std::vector<std::pair<StopIndex, std::uint32_t>>    origins_;           //  sorted by stop
+};
+
+#endif // TRANSFER_PATTERNS_HPP
@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "../utility/binary_io.hpp"
+#include "trip_based.hpp"
+
+using Utility::read32;
+using Utility::read64;
+using Utility::write32;
+using Utility::write64;
+
+namespace {
+
+const Time          infinity = Time::max();
+const std::uint64_t magic = 0x31726274; //  "tbr1"
+
+}
+
+TripBased::TripBased(const Lines& lines, Day day, unsigned threads):
+    table_{lines, day, true}, transferOffsets_{}, transfers_{} {
+
+    computeTransfers(threads);
+}
+
+TripBased::TripBased(const Lines& lines, Day day, std::istream& is):
+    table_{lines, day, true}, transferOffsets_{}, transfers_{} {
+
+    if (read64(is) != magic) {
+        throw std::runtime_error("Not trip based data");
+    }
+    if (read64(is) != table_.fingerprint() || read64(is) != table_.eventCount()) {
+        throw std::runtime_error("Trip based data is stale, the timetable has changed");
+    }
+    auto    count = read64(is);
+    transferOffsets_.reserve(table_.eventCount() + 1);
+    transferOffsets_.push_back(0);
+    for (size_t e = 0; e < table_.eventCount(); ++e) {
+        transferOffsets_.push_back(transferOffsets_.back() + read32(is));
+    }
+    if (transferOffsets_.back() != count) {
+        throw std::runtime_error("Corrupt trip based data");
+    }
+    transfers_.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        Transfer    transfer;
+        transfer.trip = read32(is);
+        transfer.position = read32(is);
+        if (transfer.trip >= table_.tripCount() ||
+            transfer.position >= table_.pattern(table_.tripPattern(transfer.trip)).stopCount) {
+            throw std::runtime_error("Corrupt trip based data");
+        }
+        transfers_.push_back(transfer);
+    }
+}
+
+void TripBased::write(std::ostream& os) const {
+    write64(os, magic);
+    write64(os, table_.fingerprint());
+    write64(os, table_.eventCount());
+    write64(os, transfers_.size());
+    for (size_t e = 0; e < table_.eventCount(); ++e) {
+        write32(os, static_cast<std::uint32_t>(transferOffsets_[e + 1] - transferOffsets_[e]));
+    }
+    for (const auto& transfer: transfers_) {
+        write32(os, transfer.trip);
+        write32(os, transfer.position);
+    }
+}
+
+//  Trips are split in contiguous ranges, one per thread. Events are numbered trip after trip,
+//  so the transfers of each range come out sorted by event and are just concatenated.
+void TripBased::computeTransfers(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    auto    tripCount = table_.tripCount();
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(1, tripCount)));
+
+    std::vector<std::vector<std::pair<size_t, Transfer>>>   results(threads);
+    std::vector<std::thread>                                workers;
+    for (unsigned i = 0; i < threads; ++i) {
+        auto    first = static_cast<TripIndex>(tripCount * i / threads);
+        auto    last = static_cast<TripIndex>(tripCount * (i + 1) / threads);
+        workers.emplace_back([this, first, last, &results, i]() {
+            computeTransfers(first, last, results[i]);
+        });
+    }
+    for (auto& worker: workers) {
+        worker.join();
+    }
+
+    transferOffsets_.assign(table_.eventCount() + 1, 0);
+    for (const auto& result: results) {
+        for (const auto& eventTransfer: result) {
+            ++transferOffsets_[eventTransfer.first + 1];
+            transfers_.push_back(eventTransfer.second);
+        }
+    }
+    for (size_t e = 0; e < table_.eventCount(); ++e) {
+        transferOffsets_[e + 1] += transferOffsets_[e];
+    }
+}
+
+//  For every stop event of the trips in [first, last), the transfers to the first trip of each
+//  pattern reachable from its stop (directly or walking), without the ones that would be
+//  better done earlier on the same trip (U-turns) and the ones that never bring an earlier
+//  arrival at any stop than the trip itself or a later transfer from it (Witt's reduction).
+void TripBased::computeTransfers(
+    TripIndex first, TripIndex last, std::vector<std::pair<size_t, Transfer>>& out) const {
+
+    struct Candidate {
+        std::uint32_t   position;
+        Transfer        transfer;
+    };
+    std::vector<Candidate>  candidates;
+    std::vector<Time>       tau(table_.stopCount(), infinity);
+    std::vector<StopIndex>  touched;
+
+    auto    improve = [&tau, &touched](StopIndex stopIx, Time time) {
+        if (time < tau[stopIx]) {
+            if (tau[stopIx] == infinity) {
+                touched.push_back(stopIx);
+            }
+            tau[stopIx] = time;
+            return true;
+        }
+        return false;
+    };
+    auto    improve_around = [this, &improve](StopIndex stopIx, Time time) {
+        auto    rv = improve(stopIx, time);
+        for (const auto& footpath: table_.footpaths(stopIx)) {
+            rv = improve(footpath.stop, time + footpath.duration) || rv;
+        }
+        return rv;
+    };
+
+    for (auto trip = first; trip < last; ++trip) {
+        auto        patternIx = table_.tripPattern(trip);
+        const auto& pattern = table_.pattern(patternIx);
+        auto        n = pattern.stopCount;
+
+        candidates.clear();
+        for (size_t i = 1; i < n; ++i) {
+            auto    arrival = table_.time(trip, i);
+            auto    stopIx = table_.patternStop(patternIx, i);
+            auto    add = [&](StopIndex toStop, DifTime walk) {
+                for (const auto& stopPosition: table_.stopPositions(toStop)) {
+                    const auto& toPattern = table_.pattern(stopPosition.pattern);
+                    auto        j = stopPosition.position;
+                    if (j + 1 >= toPattern.stopCount) {
+                        continue;
+                    }
+                    auto    toTrip = table_.earliestTrip(stopPosition.pattern, j, arrival + walk + transferTime);
+                    if (toTrip == table_.tripCount()) {
+                        continue;
+                    }
+                    //  staying on board is never worse
+                    if (stopPosition.pattern == patternIx && j >= i && toTrip >= trip) {
+                        continue;
+                    }
+                    //  U-turn: the next stop of the other trip is the previous one of this
+                    if (table_.patternStop(stopPosition.pattern, j + 1) == table_.patternStop(patternIx, i - 1) &&
+                        table_.time(trip, i - 1) + transferTime <= table_.time(toTrip, j + 1)) {
+                        continue;
+                    }
+                    candidates.push_back(Candidate{static_cast<std::uint32_t>(i), Transfer{toTrip, j}});
+                }
+            };
+            add(stopIx, DifTime{0});
+            for (const auto& footpath: table_.footpaths(stopIx)) {
+                add(footpath.stop, footpath.duration);
+            }
+        }
+
+        std::vector<bool>   keep(candidates.size(), false);
+        auto                c = candidates.size();
+        for (auto i = n - 1; i > 0; --i) {
+            improve_around(table_.patternStop(patternIx, i), table_.time(trip, i));
+            for (; c > 0 && candidates[c - 1].position == i; --c) {
+                const auto& transfer = candidates[c - 1].transfer;
+                auto        toPatternIx = table_.tripPattern(transfer.trip);
+                auto        toCount = table_.pattern(toPatternIx).stopCount;
+                for (auto k = transfer.position + 1; k < toCount; ++k) {
+                    if (improve_around(table_.patternStop(toPatternIx, k), table_.time(transfer.trip, k))) {
+                        keep[c - 1] = true;
+                    }
+                }
+            }
+        }
+        for (size_t k = 0; k < candidates.size(); ++k) {
+            if (keep[k]) {
+                out.emplace_back(table_.event(trip, candidates[k].position), candidates[k].transfer);
+            }
+        }
+
+        for (auto stopIx: touched) {
+            tau[stopIx] = infinity;
+        }
+        touched.clear();
+    }
+}
+
+//  Breadth first search on the reversed table from 'origin', leaving at 'start': every round
+//  scans the segments reached with one more transfer. 'reached' is called with each stop event
+//  of a segment in turn; the scan of the segment stops when it returns false.
+template <typename Reached>
+void TripBased::search(
+    StopIndex origin, Time start, std::vector<Segment>& segments, Reached reached, QueryStats* stats) const {
+
+    std::vector<std::uint32_t>  firstReached(table_.tripCount(), std::numeric_limits<std::uint32_t>::max());
+
+    auto    enqueue = [this, &firstReached, &segments](
+        TripIndex trip, std::uint32_t position, size_t parent, std::uint32_t parentPosition, DifTime walk) {
+
+        if (position >= firstReached[trip]) {
+            return;
+        }
+        const auto& pattern = table_.pattern(table_.tripPattern(trip));
+        auto        end = static_cast<std::uint32_t>(std::min<size_t>(firstReached[trip], pattern.stopCount));
+        segments.push_back(Segment{trip, position, end, parent, parentPosition, walk});
+        for (auto u = trip; u < pattern.firstTrip + pattern.tripCount && firstReached[u] > position; ++u) {
+            firstReached[u] = position;
+        }
+    };
+
+    std::vector<TripTable::Footpath>    origins{TripTable::Footpath{origin, DifTime{0}}};
+    origins.insert(origins.end(), table_.footpaths(origin).begin(), table_.footpaths(origin).end());
+    for (const auto& footpath: origins) {
+        for (const auto& stopPosition: table_.stopPositions(footpath.stop)) {
+            if (stopPosition.position + 1 >= table_.pattern(stopPosition.pattern).stopCount) {
+                continue;
+            }
+            if (stats) {
+                stats->count(Counter::lowerBounds);
+            }
+            auto    trip = table_.earliestTrip(stopPosition.pattern, stopPosition.position, start + footpath.duration);
+            if (trip != table_.tripCount()) {
+                enqueue(trip, stopPosition.position, noSegment, 0, footpath.duration);
+            }
+        }
+    }
+
+    for (size_t s = 0; s < segments.size(); ++s) {
+        auto    segment = segments[s];
+        auto    patternIx = table_.tripPattern(segment.trip);
+        if (stats) {
+            stats->count(Counter::verticesSettled);
+        }
+        for (auto k = segment.first + 1; k < segment.end; ++k) {
+            if (!reached(s, k, table_.patternStop(patternIx, k), table_.time(segment.trip, k))) {
+                break;
+            }
+            for (const auto& transfer: transfers(segment.trip, k)) {
+                if (stats) {
+                    stats->count(Counter::edgesRelaxed);
+                }
+                enqueue(transfer.trip, transfer.position, s, k, DifTime{0});
+            }
+        }
+    }
+}
+
+//  The segment reached last is the first leg of the journey in the original direction.
+void TripBased::makeJourney(
+    const std::vector<Segment>& segments, const Arrival& arrival,
+    StopIndex origin, Time start, StopIndex target, Journey& journey) const {
+
+    auto    add_walk = [this, &journey](StopIndex from, Time leave, StopIndex to, DifTime duration) {
+        journey.push_back(JourneyLeg{
+            walkingRouteId, {{table_.stop(from), leave}, {table_.stop(to), leave + duration}}});
+    };
+
+    journey.clear();
+    if (arrival.segment == noSegment) {
+        auto    arrive = Time{-start.time_since_epoch()};
+        add_walk(target, arrive - arrival.walk, origin, arrival.walk);
+        return;
+    }
+
+    auto    s = arrival.segment;
+    auto    k = arrival.position;
+    auto    stopIx = table_.patternStop(table_.tripPattern(segments[s].trip), k);
+    if (stopIx != target) {
+        auto    leave = table_.originalTime(segments[s].trip, k) - arrival.walk;
+        add_walk(target, leave, stopIx, arrival.walk - transferTime);
+    }
+    while (true) {
+        const auto& segment = segments[s];
+        auto        patternIx = table_.tripPattern(segment.trip);
+        JourneyLeg  leg{table_.pattern(patternIx).routeid, {}};
+        for (auto pos = k + 1; pos-- > segment.first;) {
+            leg.stops.emplace_back(table_.stop(table_.patternStop(patternIx, pos)), table_.originalTime(segment.trip, pos));
+        }
+        journey.push_back(std::move(leg));
+
+        auto    alightIx = table_.patternStop(patternIx, segment.first);
+        auto    alightTime = table_.originalTime(segment.trip, segment.first);
+        if (segment.parent == noSegment) {
+            if (alightIx != origin) {
+                add_walk(alightIx, alightTime, origin, segment.walk);
+            }
+            break;
+        }
+        const auto& parent = segments[segment.parent];
+        auto        boardIx = table_.patternStop(table_.tripPattern(parent.trip), segment.parentPosition);
+        if (boardIx != alightIx) {
+            add_walk(alightIx, alightTime, boardIx, table_.walkingTime(alightIx, boardIx));
+        }
+        s = segment.parent;
+        k = segment.parentPosition;
+    }
+}
+
+bool TripBased::planFromArrive(
+    const Stop& from, const Stop& to, Time arrive, Journey& journey, QueryStats* stats) const {
+
+    //  On the reversed table the search goes from 'to', leaving at -arrive, to 'from'.
+    StopIndex   origin, target;
+    if (!table_.findStop(to, origin)) {
+        throw std::out_of_range(std::string{"Unknown stop "}.append(to));
+    }
+    if (!table_.findStop(from, target)) {
+        throw std::out_of_range(std::string{"Unknown stop "}.append(from));
+    }
+    journey.clear();
+    if (origin == target) {
+        return false;
+    }
+
+    //  stops from which the target is reached, with the walk; walking onto a bus takes
+    //  transferTime, walking off it does not.
+    std::vector<TripTable::Footpath>    targets{TripTable::Footpath{target, DifTime{0}}};
+    for (const auto& footpath: table_.footpaths(target)) {
+        targets.push_back(TripTable::Footpath{footpath.stop, footpath.duration + transferTime});
+    }
+
+    ScopedTimer             searchTimer{stats, Phase::search};
+    auto                    start = Time{-arrive.time_since_epoch()};
+    std::vector<Segment>    segments;
+    Time                    best = infinity;
+    Arrival                 bestArrival{noSegment, 0, DifTime{0}};
+    auto                    walk = table_.walkingTime(origin, target);
+    if (walk >= DifTime{0}) {
+        best = start + walk;
+        bestArrival.walk = walk;
+    }
+    search(origin, start, segments, [&targets, &best, &bestArrival](
+        size_t s, std::uint32_t k, StopIndex stopIx, Time time) {
+
+        if (time >= best) {
+            return false;
+        }
+        for (const auto& t: targets) {
+            if (t.stop == stopIx && time + t.duration < best) {
+                best = time + t.duration;
+                bestArrival = Arrival{s, k, t.duration};
+            }
+        }
+        return true;
+    }, stats);
+    searchTimer.stop();
+    if (best == infinity) {
+        return false;
+    }
+
+    ScopedTimer reconstructionTimer{stats, Phase::reconstruction};
+    makeJourney(segments, bestArrival, origin, start, target, journey);
+    return true;
+}
+
+void TripBased::searchAll(
+    StopIndex origin, Time start, std::vector<Segment>& segments, std::vector<Time>& best,
+    std::vector<Arrival>& arrivals) const {
+
+    segments.clear();
+    best.assign(table_.stopCount(), infinity);
+    arrivals.assign(table_.stopCount(), Arrival{noSegment, 0, DifTime{0}});
+    for (const auto& footpath: table_.footpaths(origin)) {
+        best[footpath.stop] = start + footpath.duration;
+        arrivals[footpath.stop].walk = footpath.duration;
+    }
+    search(origin, start, segments, [this, &best, &arrivals](
+        size_t s, std::uint32_t k, StopIndex stopIx, Time time) {
+
+        if (time < best[stopIx]) {
+            best[stopIx] = time;
+            arrivals[stopIx] = Arrival{s, k, DifTime{0}};
+        }
+        for (const auto& footpath: table_.footpaths(stopIx)) {
+            auto    walk = footpath.duration + transferTime;
+            if (time + walk < best[footpath.stop]) {
+                best[footpath.stop] = time + walk;
+                arrivals[footpath.stop] = Arrival{s, k, walk};
+            }
+        }
+        return true;
+    }, nullptr);
+}
+
+void TripBased::transferStopsFromArrive(
+    StopIndex to, Time arrive, std::vector<TransferStops>& transferStops) const {
+
+    auto                    start = Time{-arrive.time_since_epoch()};
+    std::vector<Segment>    segments;
+    std::vector<Time>       best;
+    std::vector<Arrival>    arrivals;
+    searchAll(to, start, segments, best, arrivals);
+
+    transferStops.resize(table_.stopCount());
+    for (StopIndex stopIx = 0; stopIx < table_.stopCount(); ++stopIx) {
+        auto&   stops = transferStops[stopIx];
+        stops.clear();
+        if (stopIx == to || best[stopIx] == infinity) {
+            continue;
+        }
+        const auto& arrival = arrivals[stopIx];
+        if (arrival.segment == noSegment) {
+            stops.emplace_back(stopIx, true);
+            stops.emplace_back(to, false);
+            continue;
+        }
+        auto    s = arrival.segment;
+        auto    k = arrival.position;
+        while (true) {
+            const auto& segment = segments[s];
+            auto        patternIx = table_.tripPattern(segment.trip);
+            auto        boardIx = table_.patternStop(patternIx, k);
+            if (stops.empty() && boardIx != stopIx) {
+                stops.emplace_back(stopIx, true);
+            }
+            stops.emplace_back(boardIx, false);
+            auto    alightIx = table_.patternStop(patternIx, segment.first);
+            if (segment.parent == noSegment) {
+                if (alightIx != to) {
+                    stops.emplace_back(alightIx, true);
+                }
+                break;
+            }
+            if (table_.patternStop(table_.tripPattern(segments[segment.parent].trip), segment.parentPosition) != alightIx) {
+                stops.emplace_back(alightIx, true);
+            }
+            s = segment.parent;
+            k = segment.parentPosition;
+        }
+        stops.emplace_back(to, false);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef TRIP_BASED_HPP
+#define TRIP_BASED_HPP
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "algorithm.hpp"
+#include "day.hpp"
+#include "journey.hpp"
+#include "lines.hpp"
+#include "stats.hpp"
+#include "trip_table.hpp"
+
+//  Trip based routing (Witt, 2015) for the timetable of one day.
+//
+//  Preprocessing computes, for every stop event, the transfers to other trips that can be
+//  part of an optimal journey. A query is then a breadth first search over trip segments,
+//  one round per transfer. The table is reversed, so the earliest arrival search answers the
+//  latest departure ("arrive by") queries of BusNetwork.
+class TripBased {
+public:
+    struct Transfer {
+        TripIndex       trip;
+        std::uint32_t   position;
+    };
+    using Transfers = Range<std::vector<Transfer>::const_iterator>;
+
+    //  Build the trip table of 'day' and compute its transfers, using 'threads' threads.
+    TripBased(const Lines& lines, Day day, unsigned threads = 0);
+    //  Build the trip table of 'day' and read its transfers as written by write(). Throws
+    //  std::runtime_error if they were computed for another timetable.
+    TripBased(const Lines& lines, Day day, std::istream& is);
+
+    void write(std::ostream& os) const;
+
+    const TripTable& table() const {
+        return table_;
+    }
+    size_t transferCount() const {
+        return transfers_.size();
+    }
+    //  Bytes used by the transfers and the table.
+    size_t memoryUsage() const {
+        return
+            table_.memoryUsage() +
+            transferOffsets_.capacity() * sizeof(size_t) + transfers_.capacity() * sizeof(Transfer);
+    }
+    Transfers transfers(TripIndex trip, size_t position) const {
+        auto    e = table_.event(trip, position);
+        return makeRange(transfers_.cbegin() + transferOffsets_[e], transfers_.cbegin() + transferOffsets_[e + 1]);
+    }
+
+    //  Latest departure from 'from' reaching 'to' by 'arrive'. Returns false if there is none.
+    bool planFromArrive(
+        const Stop& from, const Stop& to, Time arrive, Journey& journey, QueryStats* stats = nullptr) const;
+    //  Stops of a journey where it gets on a bus or starts walking, each one with whether it
+    //  walks from there, and its destination.
+    using TransferStops = std::vector<std::pair<StopIndex, bool>>;
+    //  Transfer stops of the latest departures from every stop reaching 'to' by 'arrive',
+    //  indexed by stop in table(); empty where there is none.
+    void transferStopsFromArrive(StopIndex to, Time arrive, std::vector<TransferStops>& transferStops) const;
+
+private:
+    static const size_t noSegment = static_cast<size_t>(-1);
+
+    struct Segment {
+        TripIndex       trip;
+        std::uint32_t   first;          //  boarding position
+        std::uint32_t   end;            //  one past the last position not reached before
+        size_t          parent;
+        std::uint32_t   parentPosition;
+        DifTime         walk;           //  from the origin, for the first segment
+    };
+    //  How a stop is reached: getting off a segment, then walking (with the change time if
+    //  it is not the last stop).
+    struct Arrival {
+        size_t          segment;
+        std::uint32_t   position;
+        DifTime         walk;
+    };
+
+    template <typename Reached>
+    void search(
+        StopIndex origin, Time start, std::vector<Segment>& segments, Reached reached, QueryStats* stats) const;
+    void searchAll(
+        StopIndex origin, Time start, std::vector<Segment>& segments, std::vector<Time>& best,
+        std::vector<Arrival>& arrivals) const;
+    void makeJourney(
+        const std::vector<Segment>& segments, const Arrival& arrival,
+        StopIndex origin, Time start, StopIndex target, Journey& journey) const;
+    void computeTransfers(unsigned threads);
+    void computeTransfers(TripIndex first, TripIndex last, std::vector<std::pair<size_t, Transfer>>& out) const;
+
+    TripTable               table_;
+    std::vector<size_t>     transferOffsets_;
+    std::vector<Transfer>   transfers_;
+};
+
+#endif // TRIP_BASED_HPP
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+#include "trip_table.hpp"
+
+namespace {
+
+Time negate(Time time) {
+    return Time{-time.time_since_epoch()};
+}
+
+//  FNV-1a
+void hash(std::uint64_t& h, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        h ^= (value >> (i * 8)) & 0xff;
+        h *= 1099511628211ull;
+    }
+}
+
+}
+
+TripTable::TripTable():
+    reversed_{false},
+    stops_{},
+    stopMap_{},
+    patterns_{},
+    patternStops_{},
+    tripPatterns_{},
+    times_{},
+    stopPositionOffsets_{0},
+    stopPositions_{},
+    footpathOffsets_{0},
+    footpaths_{} {
+}
+
+TripTable::TripTable(const Lines& lines, Day day, bool reversed): TripTable{} {
+    reversed_ = reversed;
+
+    auto    stopSet = lines.getStopSet();
+    stops_.assign(stopSet.cbegin(), stopSet.cend());
+    for (size_t i = 0; i < stops_.size(); ++i) {
+        stopMap_[stops_[i]] = static_cast<StopIndex>(i);
+    }
+
+    std::vector<std::vector<StopPosition>>  positions(stops_.size());
+    lines.forEachRoute([this, day, &positions](const RouteId& routeid, const Route& route) {
+        const auto& rstops = route.stops();
+        route.schedule(day).forEachFragment([this, &routeid, &rstops, &positions](
+            size_t fromIx, const Fragment& fragment) {
+
+            auto    n = fragment.stopCount();
+            auto    m = fragment.timeLinesCount();
+            if (n < 2 || m == 0) {
+                return;
+            }
+            auto    original = [this, n](size_t position) {
+                return reversed_ ? n - 1 - position : position;
+            };
+            //  decoded once, rather than a block per time
+            auto    table = fragment.getTimes();
+            auto    time_at = [this, &table, n, &original](size_t timelineIx, size_t position) {
+                auto    time = table[timelineIx * n + original(position)];
+                return reversed_ ? negate(time) : time;
+            };
+
+            std::vector<size_t> order(m);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&time_at](size_t a, size_t b) {
+                return time_at(a, 0) < time_at(b, 0);
+            });
+            //  a fragment may mix trips of different durations: a trip overtaking another one goes
+            //  to the first group it overtakes nothing in, so that the trips of every pattern keep
+            //  their order at every stop.
+            std::vector<std::vector<size_t>>    groups;
+            for (auto timelineIx: order) {
+                auto    groupIt = std::find_if(groups.begin(), groups.end(), [&time_at, timelineIx, n](
+                    const std::vector<size_t>& group) {
+
+                    for (size_t pos = 0; pos < n; ++pos) {
+                        if (time_at(timelineIx, pos) < time_at(group.back(), pos)) {
+                            return false;
+                        }
+                    }
+                    return true;
+                });
+                if (groupIt == groups.end()) {
+                    groupIt = groups.emplace(groups.end());
+                }
+                groupIt->push_back(timelineIx);
+            }
+
+            for (const auto& group: groups) {
+                auto    patternIx = static_cast<PatternIndex>(patterns_.size());
+                patterns_.push_back(Pattern{
+                    routeid, patternStops_.size(), n, static_cast<TripIndex>(tripPatterns_.size()), group.size(),
+                    times_.size()});
+                for (size_t pos = 0; pos < n; ++pos) {
+                    auto    stopIx = stopMap_.at(rstops.at(fromIx + original(pos)));
+                    patternStops_.push_back(stopIx);
+                    positions[stopIx].push_back(StopPosition{patternIx, static_cast<std::uint32_t>(pos)});
+                }
+                for (auto timelineIx: group) {
+                    for (size_t pos = 0; pos < n; ++pos) {
+                        times_.push_back(time_at(timelineIx, pos));
+                    }
+                    tripPatterns_.push_back(patternIx);
+                }
+            }
+        });
+    });
+
+#ifndef NDEBUG
+    //  earliestTrip() searches the columns of the patterns: every one is sorted.
+    for (const auto& p: patterns_) {
+        for (size_t trip = 1; trip < p.tripCount; ++trip) {
+            for (size_t pos = 0; pos < p.stopCount; ++pos) {
+                auto    event = p.firstEvent + trip * p.stopCount + pos;
+                assert(times_[event - p.stopCount] <= times_[event]);
+            }
+        }
+    }
+#endif
+
+    for (const auto& stopPositions: positions) {
+        stopPositions_.insert(stopPositions_.end(), stopPositions.cbegin(), stopPositions.cend());
+        stopPositionOffsets_.push_back(stopPositions_.size());
+    }
+
+    std::vector<std::vector<Footpath>>  footpaths(stops_.size());
+    for (const auto& walkingTime: lines.walkingTimes()) {
+        auto    a = stopMap_.at(walkingTime.first.first);
+        auto    b = stopMap_.at(walkingTime.first.second);
+        footpaths[a].push_back(Footpath{b, walkingTime.second});
+        footpaths[b].push_back(Footpath{a, walkingTime.second});
+    }
+    for (auto& stopFootpaths: footpaths) {
+        std::sort(stopFootpaths.begin(), stopFootpaths.end(), [](const Footpath& a, const Footpath& b) {
+            return a.duration < b.duration;
+        });
+        footpaths_.insert(footpaths_.end(), stopFootpaths.cbegin(), stopFootpaths.cend());
+        footpathOffsets_.push_back(footpaths_.size());
+    }
+}
+
+bool TripTable::findStop(const Stop& stop, StopIndex& stopIx) const {
+    auto    it = stopMap_.find(stop);
+    if (it == stopMap_.cend()) {
+        return false;
+    }
+    stopIx = it->second;
+    return true;
+}
+
+TripIndex TripTable::earliestTrip(PatternIndex patternIx, size_t position, Time time) const {
+    const auto& p = patterns_[patternIx];
+    size_t      first = 0;
+    size_t      count = p.tripCount;
+    while (count > 0) {
+        auto    step = count / 2;
+        auto    middle = first + step;
+        if (times_[p.firstEvent + middle * p.stopCount + position] < time) {
+            first = middle + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    return first < p.tripCount ? static_cast<TripIndex>(p.firstTrip + first) : static_cast<TripIndex>(tripCount());
+}
+
+DifTime TripTable::walkingTime(StopIndex from, StopIndex to) const {
+    for (const auto& footpath: footpaths(from)) {
+        if (footpath.stop == to) {
+            return footpath.duration;
+        }
+    }
+    return DifTime{-1};
+}
+
+size_t TripTable::memoryUsage() const {
+    size_t  rv = 0;
+    for (const auto& stop: stops_) {
+        rv += sizeof(Stop) + stop.capacity();
+    }
+    rv += stopMap_.size() * (sizeof(std::map<Stop, StopIndex>::value_type) + 4 * sizeof(void*));
+    rv += patterns_.capacity() * sizeof(Pattern);
+    rv += patternStops_.capacity() * sizeof(StopIndex);
+    rv += tripPatterns_.capacity() * sizeof(PatternIndex);
+    rv += times_.capacity() * sizeof(Time);
+    rv += stopPositionOffsets_.capacity() * sizeof(size_t) + stopPositions_.capacity() * sizeof(StopPosition);
+    rv += footpathOffsets_.capacity() * sizeof(size_t) + footpaths_.capacity() * sizeof(Footpath);
+    return rv;
+}
+
+std::uint64_t TripTable::fingerprint() const {
+    std::uint64_t   rv = 14695981039346656037ull;
+    hash(rv, reversed_);
+    hash(rv, stops_.size());
+    hash(rv, patterns_.size());
+    hash(rv, times_.size());
+    for (auto stopIx: patternStops_) {
+        hash(rv, stopIx);
+    }
+    for (auto time: times_) {
+        hash(rv, static_cast<std::uint64_t>(time.time_since_epoch().count()));
+    }
+    for (const auto& footpath: footpaths_) {
+        hash(rv, footpath.stop);
+        hash(rv, static_cast<std::uint64_t>(footpath.duration.count()));
+    }
+    return rv;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#ifndef TRIP_TABLE_HPP
+#define TRIP_TABLE_HPP
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "algorithm.hpp"
+#include "day.hpp"
+#include "lines.hpp"
+#include "stop.hpp"
+#include "time.hpp"
+
+using StopIndex = std::uint32_t;
+using PatternIndex = std::uint32_t;
+using TripIndex = std::uint32_t;
+
+//  Flat, index based view of the timetable of one day, for the trip based engines.
+//
+//  Every schedule fragment becomes patterns: a stop sequence shared by its trips, which are
+//  sorted by departure time and never overtake one another, the fragment being split where a
+//  trip does. Stop times are stored trip after trip, so a stop event (trip,
+//  position) has a single index in times(). A reversed table has every pattern walked
+//  backwards and times negated: an earliest arrival search on it answers latest departure
+//  queries on the original timetable.
+class TripTable {
+public:
+    struct Pattern {
+        RouteId     routeid;
+        size_t      firstStop;      //  into patternStops_
+        size_t      stopCount;
+        TripIndex   firstTrip;
+        size_t      tripCount;
+        size_t      firstEvent;     //  into times_
+    };
+    struct StopPosition {
+        PatternIndex    pattern;
+        std::uint32_t   position;
+    };
+    struct Footpath {
+        StopIndex   stop;
+        DifTime     duration;
+    };
+    using StopPositions = Range<std::vector<StopPosition>::const_iterator>;
+    using Footpaths = Range<std::vector<Footpath>::const_iterator>;
+
+    TripTable();
+    TripTable(const Lines& lines, Day day, bool reversed);
+
+    bool reversed() const {
+        return reversed_;
+    }
+    size_t stopCount() const {
+        return stops_.size();
+    }
+    size_t patternCount() const {
+        return patterns_.size();
+    }
+    size_t tripCount() const {
+        return tripPatterns_.size();
+    }
+    size_t eventCount() const {
+        return times_.size();
+    }
+
+    const Stop& stop(StopIndex stopIx) const {
+        return stops_[stopIx];
+    }
+    bool findStop(const Stop& stop, StopIndex& stopIx) const;
+
+    const Pattern& pattern(PatternIndex patternIx) const {
+        return patterns_[patternIx];
+    }
+    StopIndex patternStop(PatternIndex patternIx, size_t position) const {
+        return patternStops_[patterns_[patternIx].firstStop + position];
+    }
+    PatternIndex tripPattern(TripIndex trip) const {
+        return tripPatterns_[trip];
+    }
+    size_t event(TripIndex trip, size_t position) const {
+        const auto& p = patterns_[tripPatterns_[trip]];
+        return p.firstEvent + (trip - p.firstTrip) * p.stopCount + position;
+    }
+    Time time(TripIndex trip, size_t position) const {
+        return times_[event(trip, position)];
+    }
+    //  First trip of the pattern leaving 'position' at or after 'time', or tripCount() if none: a
+    //  binary search of the column, sorted since no trip of a pattern overtakes another one.
+    TripIndex earliestTrip(PatternIndex patternIx, size_t position, Time time) const;
+
+    StopPositions stopPositions(StopIndex stopIx) const {
+        return makeRange(
+            stopPositions_.cbegin() + stopPositionOffsets_[stopIx],
+            stopPositions_.cbegin() + stopPositionOffsets_[stopIx + 1]);
+    }
+    Footpaths footpaths(StopIndex stopIx) const {
+        return makeRange(
+            footpaths_.cbegin() + footpathOffsets_[stopIx],
+            footpaths_.cbegin() + footpathOffsets_[stopIx + 1]);
+    }
+    //  Walking time between two stops, or a negative duration if there is no footpath.
+    DifTime walkingTime(StopIndex from, StopIndex to) const;
+
+    //  Original (not negated) time of a stop event.
+    Time originalTime(TripIndex trip, size_t position) const {
+        return reversed_ ? Time{-time(trip, position).time_since_epoch()} : time(trip, position);
+    }
+    //  Position of the same stop in the original direction of the pattern.
+    size_t originalPosition(TripIndex trip, size_t position) const {
+        return reversed_ ? patterns_[tripPatterns_[trip]].stopCount - 1 - position : position;
+    }
+
+    //  Changes whenever the timetable does, to detect stale preprocessed data.
+    std::uint64_t fingerprint() const;
+    //  Bytes used by the table, roughly.
+    size_t memoryUsage() const;
+
+private:
+    bool                        reversed_;
+    Stops                       stops_;
+    std::map<Stop, StopIndex>   stopMap_;
+    std::vector<Pattern>        patterns_;
+    std::vector<StopIndex>      patternStops_;
+    std::vector<PatternIndex>   tripPatterns_;
+    std::vector<Time>           times_;
+    std::vector<size_t>         stopPositionOffsets_;
+    std::vector<StopPosition>   stopPositions_;
+    std::vector<size_t>         footpathOffsets_;
+    std::vector<Footpath>       footpaths_;
+};
+
+#endif // TRIP_TABLE_HPP
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "walking.hpp"
+
+DifTime walkingTime(double metres, double speed) {
+    auto    minutes = std::max(1.0, std::ceil(metres / (speed * 1000.0 / 60.0)));
+    return std::chrono::minutes{static_cast<int>(minutes)};
+}
+
+void generateWalkingTimes(
+    WalkingTimes& walkingTimes, const StopCoordinates& coordinates, const StopSet& stops, double radius,
+    double speed) {
+
+    std::vector<const Stop*>    indexed;
+    std::vector<Coordinates>    points;
+    for (const auto& stopCoordinates: coordinates) {
+        if (stops.count(stopCoordinates.first)) {
+            indexed.push_back(&stopCoordinates.first);
+            points.push_back(stopCoordinates.second);
+        }
+    }
+    //  cells as wide as the radius: a stop looks at most at the nine cells around it.
+    SpatialIndex    index{points, radius};
+    for (size_t a = 0; a < points.size(); ++a) {
+        index.forEachWithin(points[a], radius, [&](size_t b, double distance) {
+            if (b <= a) {
+                return;
+            }
+            walkingTimes.emplace(
+                std::piecewise_construct,
+                std::forward_as_tuple(*indexed[a], *indexed[b]),
+                std::forward_as_tuple(walkingTime(distance, speed)));
+        });
+    }
+}
+
+void closeWalkingTimes(WalkingTimes& walkingTimes, DifTime maxWalk) {
+    //  the stops with a walk, and their walks as an adjacency array.
+    std::vector<const Stop*>            stops;
+    std::unordered_map<Stop, size_t>    stopIxs;
+    auto    stop_index = [&stops, &stopIxs](const Stop& stop) {
+        auto    inserted = stopIxs.emplace(stop, stops.size());
+        if (inserted.second) {
+            stops.push_back(&inserted.first->first);
+        }
+        return inserted.first->second;
+    };
+    std::vector<std::pair<size_t, size_t>>  ends;
+    ends.reserve(walkingTimes.size());
+    for (const auto& walkingTime: walkingTimes) {
+        auto    a = stop_index(walkingTime.first.first);
+        ends.emplace_back(a, stop_index(walkingTime.first.second));
+    }
+
+    struct Walk {
+        size_t  to;
+        DifTime duration;
+    };
+    std::vector<size_t> offsets(stops.size() + 1, 0);
+    for (const auto& end: ends) {
+        ++offsets[end.first + 1];
+        ++offsets[end.second + 1];
+    }
+    for (size_t ix = 0; ix < stops.size(); ++ix) {
+        offsets[ix + 1] += offsets[ix];
+    }
+    std::vector<Walk>   walks(offsets.back());
+    auto                next = offsets;
+    auto                endIt = ends.cbegin();
+    for (const auto& walkingTime: walkingTimes) {
+        walks[next[endIt->first]++] = Walk{endIt->second, walkingTime.second};
+        walks[next[endIt->second]++] = Walk{endIt->first, walkingTime.second};
+        ++endIt;
+    }
+
+    //  Dijkstra from every stop, up to maxWalk; walks are symmetric, so each pair is set from
+    //  its lower index.
+    using Entry = std::pair<DifTime, size_t>;
+    std::vector<DifTime>    durations(stops.size(), DifTime::max());
+    std::vector<size_t>     reached;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    std::vector<Entry>      closure;
+    for (size_t source = 0; source < stops.size(); ++source) {
+        durations[source] = DifTime{0};
+        reached.push_back(source);
+        queue.emplace(DifTime{0}, source);
+        while (!queue.empty()) {
+            auto    entry = queue.top();
+            queue.pop();
+            auto    s = entry.second;
+            if (entry.first > durations[s]) {
+                continue;
+            }
+            if (s > source) {
+                closure.emplace_back(entry.first, s);
+            }
+            for (auto ix = offsets[s]; ix < offsets[s + 1]; ++ix) {
+                const auto& walk = walks[ix];
+                auto        duration = entry.first + walk.duration;
+                if (duration <= maxWalk && duration < durations[walk.to]) {
+                    if (durations[walk.to] == DifTime::max()) {
+                        reached.push_back(walk.to);
+                    }
+                    durations[walk.to] = duration;
+                    queue.emplace(duration, walk.to);
+                }
+            }
+        }
+        for (auto t: reached) {
+            durations[t] = DifTime::max();
+        }
+        reached.clear();
+
+        for (const auto& entry: closure) {
+            auto    inserted = walkingTimes.emplace(WalkingStep{*stops[source], *stops[entry.second]}, entry.first);
+            if (!inserted.second && entry.first < inserted.first->second) {
+                inserted.first->second = entry.first;
+            }
+        }
+        closure.clear();
+    }
+}
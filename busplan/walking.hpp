@@ -4,6 +4,8 @@
 
 #include <map>
 
+#include "../utility/arena.hpp"
+#include "spatial_index.hpp"
 #include "stop.hpp"
 #include "time.hpp"
 
@@ -17,10 +19,26 @@ struct WalkingStep: std::pair<Stop, Stop> {
     }
 };
 
-using WalkingTimes = std::map<WalkingStep, DifTime>;
+using WalkingTimes = Utility::ArenaMap<WalkingStep, DifTime>;
+using StopCoordinates = Utility::ArenaMap<Stop, Coordinates>;
+
+//  Walking speed when none is configured, in km/h.
+const double    defaultWalkingSpeed = 4.5;
 
 inline Time getArriveTime(const WalkingTimes& walkingTimes, const Stop& from, Time leave, const Stop& to) {
     return leave + walkingTimes.at(WalkingStep{from, to});
 }
 
+//  Time to walk 'metres' at 'speed' km/h, in whole minutes and at least one.
+DifTime walkingTime(double metres, double speed);
+//  Add a walk between every two of 'stops' with coordinates at most 'radius' metres apart, at
+//  'speed' km/h, unless there is one already.
+void generateWalkingTimes(
+    WalkingTimes& walkingTimes, const StopCoordinates& coordinates, const StopSet& stops, double radius,
+    double speed);
+//  Add the shortest chain of walks between every two stops that takes at most 'maxWalk', or
+//  shorten their walk to it, so that one walk is enough between any stops reached on foot. The
+//  walks given are kept whatever their length.
+void closeWalkingTimes(WalkingTimes& walkingTimes, DifTime maxWalk);
+
 #endif // WALKING_HPP
@@ -0,0 +1,12 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+CONFIG += thread
+
+include(busplan/busplan.pri)
+
+SOURCES += \
+    netcode/main.cpp
+
+unix|win32: LIBS += -lboost_program_options
@@ -0,0 +1,436 @@
+//  netcode: network compiler.
+//
+//  Loads a busplan network as busplan does, and writes a C++ source, static_network_data.cpp by
+//  default, defining staticNetwork() (see busplan/static_network.hpp) with constant tables of
+//  the loaded model and a static buffer sized to build it in, so that a busplan built with it
+//  (qmake NETWORK=DIR) starts without reading any file. It is not named after
+//  busplan/static_network.cpp, whose object file it would otherwise overwrite.
+
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/value_semantic.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "../busplan/config.hpp"
+#include "../busplan/lines.hpp"
+#include "../busplan/static_network.hpp"
+#include "../utility/ini_doc.hpp"
+
+namespace {
+
+void writeString(std::ostream& os, const char* str) {
+    os << '"';
+    for (; *str; ++str) {
+        auto    c = static_cast<unsigned char>(*str);
+        if (c == '"' || c == '\\') {
+            os << '\\' << *str;
+        } else if (c < 0x20 || c >= 0x7f) {
+            char    escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\%03o", unsigned{c});
+            os << escaped;
+        } else {
+            os << *str;
+        }
+    }
+    os << '"';
+}
+
+std::ostream& operator<<(std::ostream& os, const StaticRange& range) {
+    return os << "{" << range.first << ", " << range.size << "}";
+}
+
+void writeEntry(std::ostream& os, const char* str) {
+    writeString(os, str);
+}
+void writeEntry(std::ostream& os, std::uint32_t value) {
+    os << value;
+}
+void writeEntry(std::ostream& os, std::int32_t value) {
+    os << value;
+}
+void writeEntry(std::ostream& os, const StaticStop& stop) {
+    os << "{";
+    writeString(os, stop.name);
+    os << ", " << stop.described << ", " << stop.descriptions << ", " << stop.located << ", ";
+    os << stop.latitude << ", " << stop.longitude << "}";
+}
+void writeEntry(std::ostream& os, const StaticService& service) {
+    os << "{";
+    writeString(os, service.name);
+    os << ", " << service.first << ", " << service.last << ", " << unsigned{service.weekdays} << ", ";
+    os << service.exceptions << "}";
+}
+void writeEntry(std::ostream& os, const StaticException& exception) {
+    os << "{" << exception.date << ", " << exception.added << "}";
+}
+void writeEntry(std::ostream& os, const StaticLine& line) {
+    os << "{";
+    writeString(os, line.name);
+    os << ", " << line.routes << "}";
+}
+void writeEntry(std::ostream& os, const StaticRoute& route) {
+    os << "{";
+    writeString(os, route.name);
+    os << ", ";
+    writeString(os, route.description);
+    os << ", " << route.stops << ", " << route.platforms << ", " << route.schedules << "}";
+}
+void writeEntry(std::ostream& os, const StaticPlatform& platform) {
+    os << "{" << platform.stop << ", ";
+    writeString(os, platform.platform);
+    os << "}";
+}
+void writeEntry(std::ostream& os, const StaticSchedule& schedule) {
+    os << "{" << schedule.service << ", " << unsigned{schedule.day} << ", " << schedule.fragments << "}";
+}
+void writeEntry(std::ostream& os, const StaticFragment& fragment) {
+    os << "{" << fragment.from << ", " << fragment.stops << ", " << fragment.trips << ", " << fragment.firstTime << "}";
+}
+void writeEntry(std::ostream& os, const StaticWalk& walk) {
+    os << "{" << walk.from << ", " << walk.to << ", " << walk.minutes << "}";
+}
+void writeEntry(std::ostream& os, const StaticGroup& group) {
+    os << "{";
+    writeString(os, group.name);
+    os << ", " << group.stops << "}";
+}
+
+template <typename T>
+StaticTable<T> tableOf(const std::vector<T>& entries) {
+    return StaticTable<T>{entries.data(), static_cast<std::uint32_t>(entries.size())};
+}
+
+class Compiler {
+public:
+    Compiler(const Lines& lines, const StopDescriptions& sds, const StopGroups& groups):
+        model_(lines), sds_(sds), stopGroups_(groups) {
+    }
+
+    void run(double walkingSpeed, bool compressed) {
+        collectStops();
+        collectCalendar();
+        collectLines();
+        collectWalks();
+        collectGroups();
+        network_ = StaticNetwork{
+            tableOf(strings_), tableOf(stops_), tableOf(services_), tableOf(exceptions_), tableOf(lines_),
+            tableOf(routes_), tableOf(routeStops_), tableOf(platforms_), tableOf(schedules_),
+            tableOf(fragments_), tableOf(times_), tableOf(walks_), tableOf(groups_), tableOf(groupStops_),
+            walkingSpeed, compressed, nullptr, 0};
+        network_.arenaSize = arenaSize();
+    }
+
+    void write(std::ostream& os, const std::string& source) const {
+        os << "//  Generated by netcode from " << source << ": do not edit." << std::endl << std::endl;
+        os << "#include <cstddef>" << std::endl << std::endl;
+        os << "#include \"busplan/static_network.hpp\"" << std::endl << std::endl;
+        os << "namespace {" << std::endl << std::endl;
+        os << std::boolalpha << std::setprecision(std::numeric_limits<double>::max_digits10);
+        writeTable(os, "const char*", "strings", strings_);
+        writeTable(os, "StaticStop", "stops", stops_);
+        writeTable(os, "StaticService", "services", services_);
+        writeTable(os, "StaticException", "exceptions", exceptions_);
+        writeTable(os, "StaticLine", "lines", lines_);
+        writeTable(os, "StaticRoute", "routes", routes_);
+        writeTable(os, "std::uint32_t", "routeStops", routeStops_, 16);
+        writeTable(os, "StaticPlatform", "platforms", platforms_);
+        writeTable(os, "StaticSchedule", "schedules", schedules_);
+        writeTable(os, "StaticFragment", "fragments", fragments_);
+        writeTable(os, "std::int32_t", "times", times_, 16);
+        writeTable(os, "StaticWalk", "walks", walks_);
+        writeTable(os, "StaticGroup", "groups", groups_);
+        writeTable(os, "std::uint32_t", "groupStops", groupStops_, 16);
+        os << "alignas(std::max_align_t) char    arenaBuffer[" << network_.arenaSize << "];" << std::endl << std::endl;
+        os << "constexpr StaticNetwork   network{" << std::endl;
+        os << "    " << table("strings", strings_) << ", " << table("stops", stops_) << ", ";
+        os << table("services", services_) << ", " << table("exceptions", exceptions_) << "," << std::endl;
+        os << "    " << table("lines", lines_) << ", " << table("routes", routes_) << ", ";
+        os << table("routeStops", routeStops_) << ", " << table("platforms", platforms_) << "," << std::endl;
+        os << "    " << table("schedules", schedules_) << ", " << table("fragments", fragments_) << ", ";
+        os << table("times", times_) << ", " << table("walks", walks_) << "," << std::endl;
+        os << "    " << table("groups", groups_) << ", " << table("groupStops", groupStops_) << "," << std::endl;
+        os << "    " << network_.walkingSpeed << ", " << network_.compressed << ", arenaBuffer, sizeof(arenaBuffer)};";
+        os << std::endl << std::endl << "}" << std::endl << std::endl;
+        os << "const StaticNetwork& staticNetwork() {" << std::endl;
+        os << "    return network;" << std::endl;
+        os << "}" << std::endl;
+    }
+
+private:
+    template <typename T>
+    static void writeTable(
+        std::ostream& os, const std::string& type, const std::string& name, const std::vector<T>& entries,
+        size_t perLine = 1) {
+
+        if (entries.empty()) {
+            return;
+        }
+        os << "constexpr " << type << " " << name << "[] = {";
+        for (size_t ix = 0; ix < entries.size(); ++ix) {
+            os << (ix % perLine == 0 ? "\n    " : " ");
+            writeEntry(os, entries[ix]);
+            os << ",";
+        }
+        os << std::endl << "};" << std::endl << std::endl;
+    }
+    template <typename T>
+    static std::string table(const std::string& name, const std::vector<T>& entries) {
+        if (entries.empty()) {
+            return "{nullptr, 0}";
+        }
+        return "{" + name + ", " + std::to_string(entries.size()) + "}";
+    }
+
+    //  Kept for the tables to point to.
+    const char* intern(const std::string& str) {
+        names_.push_back(str);
+        return names_.back().c_str();
+    }
+    std::uint32_t stopIndex(const Stop& stop) const {
+        return stopIndexes_.at(stop);
+    }
+
+    void collectStops() {
+        auto    stops = model_.getStopSet();
+        for (const auto& sdp: sds_) {
+            stops.insert(sdp.first);
+        }
+        for (const auto& coordinatesp: model_.stopCoordinates()) {
+            stops.insert(coordinatesp.first);
+        }
+        for (const auto& groupp: stopGroups_) {
+            stops.insert(groupp.second.cbegin(), groupp.second.cend());
+        }
+        for (const auto& stop: stops) {
+            StaticStop  sstop{intern(stop), false, StaticRange{0, 0}, false, 0.0, 0.0};
+            auto        sdIt = sds_.find(stop);
+            if (sdIt != sds_.cend()) {
+                sstop.described = true;
+                sstop.descriptions = StaticRange{static_cast<std::uint32_t>(strings_.size()), static_cast<std::uint32_t>(sdIt->second.size())};
+                for (const auto& description: sdIt->second) {
+                    strings_.push_back(intern(description));
+                }
+            }
+            auto    coordinatesIt = model_.stopCoordinates().find(stop);
+            if (coordinatesIt != model_.stopCoordinates().cend()) {
+                sstop.located = true;
+                sstop.latitude = coordinatesIt->second.latitude;
+                sstop.longitude = coordinatesIt->second.longitude;
+            }
+            stopIndexes_[stop] = static_cast<std::uint32_t>(stops_.size());
+            stops_.push_back(sstop);
+        }
+    }
+    void collectCalendar() {
+        const auto& calendar = model_.calendar();
+        for (size_t id = 1; id <= calendar.size(); ++id) {
+            const auto&     service = calendar.service(static_cast<ServiceId>(id));
+            StaticService   sservice{
+                intern(service.name), service.first, service.last, service.weekdays,
+                StaticRange{static_cast<std::uint32_t>(exceptions_.size()), static_cast<std::uint32_t>(service.added.size() + service.removed.size())}};
+            for (auto date: service.added) {
+                exceptions_.push_back(StaticException{date, true});
+            }
+            for (auto date: service.removed) {
+                exceptions_.push_back(StaticException{date, false});
+            }
+            services_.push_back(sservice);
+        }
+    }
+    void collectLines() {
+        std::map<RouteId, const Route*> routes;
+        model_.forEachRoute([&routes](const RouteId& routeid, const Route& route) {
+            routes[routeid] = &route;
+        });
+        for (const auto& linen: model_.getLineNames()) {
+            auto    routeNames = model_.getRouteNames(linen);
+            lines_.push_back(StaticLine{
+                intern(linen), StaticRange{static_cast<std::uint32_t>(routes_.size()), static_cast<std::uint32_t>(routeNames.size())}});
+            for (const auto& routen: routeNames) {
+                collectRoute(routen, *routes.at(RouteId{linen, routen}));
+            }
+        }
+    }
+    void collectRoute(const RouteName& routen, const Route& route) {
+        StaticRoute sroute{intern(routen), intern(route.description()), {}, {}, {}};
+        const auto& stops = route.stops();
+
+        sroute.stops = StaticRange{static_cast<std::uint32_t>(routeStops_.size()), static_cast<std::uint32_t>(stops.size())};
+        sroute.platforms.first = static_cast<std::uint32_t>(platforms_.size());
+        std::set<Stop>  platformStops;
+        for (const auto& stop: stops) {
+            routeStops_.push_back(stopIndex(stop));
+            const auto& platform = route.getPlatform(stop);
+            if (!platform.empty() && platformStops.insert(stop).second) {
+                platforms_.push_back(StaticPlatform{stopIndex(stop), intern(platform)});
+            }
+        }
+        sroute.platforms.size = static_cast<std::uint32_t>(platforms_.size()) - sroute.platforms.first;
+
+        sroute.schedules.first = static_cast<std::uint32_t>(schedules_.size());
+        for (auto day: week) {
+            collectSchedule(weekdayService, day, route.schedule(day), false);
+        }
+        route.forEachService([this](ServiceId service, const Schedule& schedule) {
+            collectSchedule(service, 0, schedule, true);
+        });
+        sroute.schedules.size = static_cast<std::uint32_t>(schedules_.size()) - sroute.schedules.first;
+        routes_.push_back(sroute);
+    }
+    //  Timetables of weekdays without trips are left out.
+    void collectSchedule(ServiceId service, size_t day, const Schedule& schedule, bool always) {
+        StaticSchedule  sschedule{service, static_cast<std::uint8_t>(day), StaticRange{static_cast<std::uint32_t>(fragments_.size()), 0}};
+        schedule.forEachFragment([this](size_t fromIx, const Fragment& fragment) {
+            fragments_.push_back(StaticFragment{
+                static_cast<std::uint32_t>(fromIx), static_cast<std::uint32_t>(fragment.stopCount()),
+                static_cast<std::uint32_t>(fragment.timeLinesCount()), static_cast<std::uint32_t>(times_.size())});
+            for (auto time: fragment.getTimes()) {
+                times_.push_back(time.time_since_epoch().count());
+            }
+        });
+        sschedule.fragments.size = static_cast<std::uint32_t>(fragments_.size()) - sschedule.fragments.first;
+        if (always || sschedule.fragments.size) {
+            schedules_.push_back(sschedule);
+        }
+    }
+    void collectWalks() {
+        for (const auto& walkp: model_.walkingTimes()) {
+            walks_.push_back(StaticWalk{
+                stopIndex(walkp.first.first), stopIndex(walkp.first.second), walkp.second.count()});
+        }
+    }
+    void collectGroups() {
+        for (const auto& groupp: stopGroups_) {
+            groups_.push_back(StaticGroup{
+                intern(groupp.first), StaticRange{static_cast<std::uint32_t>(groupStops_.size()), static_cast<std::uint32_t>(groupp.second.size())}});
+            for (const auto& stop: groupp.second) {
+                groupStops_.push_back(stopIndex(stop));
+            }
+        }
+    }
+
+    //  Bytes the model takes in a single block: built once to know how much room it needs,
+    //  then again in a buffer that large.
+    size_t arenaSize() const {
+        size_t  size = 0;
+        {
+            Lines               lines;
+            StopDescriptions    sds;
+            StopGroups          groups;
+            read(network_, lines, sds, groups);
+            size = lines.arena().capacity();
+        }
+        std::unique_ptr<char[]> buffer{new char[size]};
+        auto                    network = network_;
+        network.arenaBuffer = buffer.get();
+        network.arenaSize = size;
+
+        Lines               lines;
+        StopDescriptions    sds;
+        StopGroups          groups;
+        read(network, lines, sds, groups);
+        if (lines.arena().blockCount() != 0) {
+            throw std::logic_error("the model does not fit in the arena buffer");
+        }
+        return size - lines.arena().left();
+    }
+
+    const Lines&                    model_;
+    const StopDescriptions&         sds_;
+    const StopGroups&               stopGroups_;
+
+    std::deque<std::string>         names_;
+    std::map<Stop, std::uint32_t>   stopIndexes_;
+    std::vector<const char*>        strings_;
+    std::vector<StaticStop>         stops_;
+    std::vector<StaticService>      services_;
+    std::vector<StaticException>    exceptions_;
+    std::vector<StaticLine>         lines_;
+    std::vector<StaticRoute>        routes_;
+    std::vector<std::uint32_t>      routeStops_;
+    std::vector<StaticPlatform>     platforms_;
+    std::vector<StaticSchedule>     schedules_;
+    std::vector<StaticFragment>     fragments_;
+    std::vector<std::int32_t>       times_;
+    std::vector<StaticWalk>         walks_;
+    std::vector<StaticGroup>        groups_;
+    std::vector<std::uint32_t>      groupStops_;
+    StaticNetwork                   network_;
+};
+
+}
+
+int main(int argc, char *argv[])
+{
+    namespace po = boost::program_options;
+
+    std::string networkDir;
+    std::string outputFile;
+
+    po::options_description desc("Options");
+    desc.add_options()
+        ("help", "show this help")
+        ("network", po::value<std::string>(&networkDir)->value_name("DIR")->default_value("."),
+            "directory of busplan.cfg")
+        ("output", po::value<std::string>(&outputFile)->value_name("FILE")->default_value("static_network_data.cpp"),
+            "generated source ('-' for stdout)")
+        ;
+    po::variables_map   vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch (const po::error& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "(Try \"netcode --help\")" << std::endl;
+        return 1;
+    }
+    if (vm.count("help")) {
+        std::cout << "Usage:" << std::endl;
+        std::cout << "  netcode [options]" << std::endl << std::endl;
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    try {
+        Utility::IniDoc     config;
+        Lines               lines;
+        StopDescriptions    sds;
+        StopGroups          groups;
+        getConfig(config, networkDir + "/busplan.cfg");
+        resolveImports(config, networkDir);
+        read(config.doc(), lines, sds);
+        read(config.doc(), groups);
+
+        const auto& root = config.doc().at("");
+        Compiler    compiler{lines, sds, groups};
+        compiler.run(
+            walkingSpeed(config.doc()),
+            root.count("compress-timetables") && root.at("compress-timetables").string() == "yes");
+        if (outputFile == "-") {
+            compiler.write(std::cout, networkDir);
+        } else {
+            std::ofstream   os(outputFile);
+            if (!os.is_open()) {
+                throw std::runtime_error(std::string{"Unable to open \""}.append(outputFile).append("\""));
+            }
+            compiler.write(os, networkDir);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+    return 0;
+}
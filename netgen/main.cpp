@@ -0,0 +1,301 @@
+//  netgen: synthetic network generator.
+//
+//  Writes a busplan network (busplan.cfg, stops.cfg, walking.cfg, lines.cfg) with stops laid
+//  out on a grid, with their coordinates, and lines following random walks over it, so that load and query performance
+//  can be measured on networks of any size, reproducibly for a given seed.
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/value_semantic.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+namespace {
+
+struct Parameters {
+    size_t          stopCount;
+    size_t          lineCount;
+    size_t          routeLength;
+    unsigned        peakHeadway;
+    unsigned        offPeakHeadway;
+    unsigned        weekendHeadway;
+    double          transferDensity;
+    double          spacing;
+    unsigned long   seed;
+    std::string     outputDir;
+};
+
+class Generator {
+public:
+    explicit Generator(const Parameters& params):
+        params_(params),
+        width_{static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(params.stopCount))))},
+        random_{params.seed} {
+    }
+
+    void run() {
+        writeStops();
+        writeWalking();
+        writeLines();
+        writeMain();
+        std::clog << "stops: " << params_.stopCount << ", lines: " << params_.lineCount;
+        std::clog << ", stop events per week: " << stopEvents_ << std::endl;
+    }
+
+private:
+    using Path = std::vector<size_t>;
+
+    static std::string stopCode(size_t stopIx) {
+        return "S" + std::to_string(stopIx);
+    }
+    static std::string lineName(size_t lineIx) {
+        return "L" + std::to_string(lineIx);
+    }
+    static std::string toTimeString(unsigned minutes) {
+        std::string rv;
+        auto        h = minutes / 60;
+        auto        m = minutes % 60;
+        rv.append(h < 10 ? "0" : "").append(std::to_string(h)).append(":");
+        rv.append(m < 10 ? "0" : "").append(std::to_string(m));
+        return rv;
+    }
+
+    std::ofstream open(const std::string& fname) const {
+        std::ofstream   os(params_.outputDir + "/" + fname);
+        if (!os.is_open()) {
+            throw std::runtime_error(
+                std::string{"Unable to open \""}.append(params_.outputDir).append("/").append(fname).append("\""));
+        }
+        return os;
+    }
+
+    //  Grid neighbours of a stop that exist.
+    std::vector<size_t> neighbours(size_t stopIx) const {
+        std::vector<size_t> rv;
+        auto                x = stopIx % width_;
+        auto                y = stopIx / width_;
+        if (x > 0) {
+            rv.push_back(stopIx - 1);
+        }
+        if (x + 1 < width_ && stopIx + 1 < params_.stopCount) {
+            rv.push_back(stopIx + 1);
+        }
+        if (y > 0) {
+            rv.push_back(stopIx - width_);
+        }
+        if (stopIx + width_ < params_.stopCount) {
+            rv.push_back(stopIx + width_);
+        }
+        return rv;
+    }
+
+    //  Random walk over the grid without revisiting stops.
+    Path randomPath() {
+        std::uniform_int_distribution<size_t>   startDist{0, params_.stopCount - 1};
+        Path                                    rv{startDist(random_)};
+        std::set<size_t>                        visited{rv.front()};
+        while (rv.size() < params_.routeLength) {
+            auto    candidates = neighbours(rv.back());
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&visited](size_t s) {
+                return visited.count(s) != 0;
+            }), candidates.end());
+            if (candidates.empty()) {
+                break;
+            }
+            std::uniform_int_distribution<size_t>   pick{0, candidates.size() - 1};
+            rv.push_back(candidates[pick(random_)]);
+            visited.insert(rv.back());
+        }
+        return rv;
+    }
+
+    void writeStops() {
+        auto    os = open("stops.cfg");
+        os << "[stops]" << std::endl;
+        //  the grid starts in Luxembourg, 'spacing' metres between neighbours.
+        const double    latitude = 49.6, longitude = 6.1;
+        const double    metresPerDegree = 111320.0;
+        auto            degreesY = params_.spacing / metresPerDegree;
+        auto            degreesX = degreesY / std::cos(latitude * std::acos(-1.0) / 180.0);
+        for (size_t i = 0; i < params_.stopCount; ++i) {
+            os << stopCode(i) << "=Stop " << i << std::endl;
+        }
+        os << std::endl << "[coordinates]" << std::endl;
+        os << std::fixed << std::setprecision(6);
+        for (size_t i = 0; i < params_.stopCount; ++i) {
+            os << stopCode(i) << "=" << latitude + (i / width_) * degreesY;
+            os << "," << longitude + (i % width_) * degreesX << std::endl;
+        }
+    }
+
+    void writeWalking() {
+        auto                                    os = open("walking.cfg");
+        std::bernoulli_distribution             hasWalk{params_.transferDensity};
+        std::uniform_int_distribution<unsigned> walkDist{1, 5};
+        os << "[walking]" << std::endl;
+        for (size_t i = 0; i < params_.stopCount; ++i) {
+            if (!hasWalk(random_)) {
+                continue;
+            }
+            auto    candidates = neighbours(i);
+            std::uniform_int_distribution<size_t>   pick{0, candidates.size() - 1};
+            if (!candidates.empty()) {
+                os << stopCode(i) << "," << stopCode(candidates[pick(random_)]) << "=0:0" << walkDist(random_) << std::endl;
+            }
+        }
+    }
+
+    //  Trips between 05:00 and 24:00, with peak hours 07:00-09:00 and 16:00-19:00 on weekdays.
+    void writeTimetable(std::ostream& os, bool weekday, size_t stopCount) {
+        std::vector<std::pair<unsigned, unsigned>>  periods;
+        if (weekday) {
+            periods = {
+                {5 * 60, params_.offPeakHeadway},
+                {7 * 60, params_.peakHeadway},
+                {9 * 60, params_.offPeakHeadway},
+                {16 * 60, params_.peakHeadway},
+                {19 * 60, params_.offPeakHeadway},
+                {24 * 60, 0}};
+        } else {
+            periods = {{6 * 60, params_.weekendHeadway}, {24 * 60, 0}};
+        }
+        std::uniform_int_distribution<unsigned> offsetDist{0, periods.front().second - 1};
+        auto                                    offset = offsetDist(random_);
+        for (size_t p = 0; p + 1 < periods.size(); ++p) {
+            auto    start = periods[p].first + offset;
+            auto    headway = periods[p].second;
+            auto    end = periods[p + 1].first;
+            if (start >= end) {
+                continue;
+            }
+            auto    rep = (end - start - 1) / headway + 1;
+            os << toTimeString(start) << "=a," << rep << "," << headway << std::endl;
+            stopEvents_ += rep * stopCount * (weekday ? 5 : 1);
+        }
+    }
+
+    void writeRoute(std::ostream& os, const std::string& sname, const Path& path) {
+        std::uniform_int_distribution<unsigned> stepDist{1, 3};
+
+        os << "[" << sname << "]" << std::endl;
+        os << "description=" << stopCode(path.front()) << " - " << stopCode(path.back()) << std::endl;
+        os << "stops=" << stopCode(path.front());
+        std::for_each(path.cbegin() + 1, path.cend(), [&os](size_t s) {
+            os << "," << stopCode(s);
+        });
+        os << std::endl;
+        os << "timetables=Sun,MonToFri,MonToFri,MonToFri,MonToFri,MonToFri,Sat" << std::endl;
+        os << "[" << sname << ".platforms]" << std::endl;
+        os << "[" << sname << ".durations]" << std::endl;
+        os << "a=" << stepDist(random_);
+        for (size_t i = 2; i < path.size(); ++i) {
+            os << "," << stepDist(random_);
+        }
+        os << std::endl;
+        os << "[" << sname << ".MonToFri]" << std::endl;
+        writeTimetable(os, true, path.size());
+        os << "[" << sname << ".Sat]" << std::endl;
+        writeTimetable(os, false, path.size());
+        os << "[" << sname << ".Sun]" << std::endl;
+        writeTimetable(os, false, path.size());
+    }
+
+    void writeLines() {
+        auto    os = open("lines.cfg");
+        for (size_t l = 0; l < params_.lineCount; ++l) {
+            auto    path = randomPath();
+            if (path.size() < 2) {
+                continue;
+            }
+            auto    linen = lineName(l);
+            lineNames_.push_back(linen);
+            os << "[" << linen << "]" << std::endl;
+            os << "routes=out,back" << std::endl;
+            writeRoute(os, linen + ".out", path);
+            std::reverse(path.begin(), path.end());
+            writeRoute(os, linen + ".back", path);
+        }
+    }
+
+    void writeMain() {
+        auto    os = open("busplan.cfg");
+        os << "imports=stops.cfg,walking.cfg,lines.cfg" << std::endl;
+        os << "lines=";
+        for (size_t l = 0; l < lineNames_.size(); ++l) {
+            os << (l ? "," : "") << lineNames_[l];
+        }
+        os << std::endl;
+    }
+
+    Parameters                  params_;
+    size_t                      width_;
+    std::mt19937_64             random_;
+    std::vector<std::string>    lineNames_;
+    unsigned long long          stopEvents_ = 0;
+};
+
+}
+
+int main(int argc, char *argv[])
+{
+    namespace po = boost::program_options;
+
+    Parameters  params;
+
+    po::options_description desc("Options");
+    desc.add_options()
+        ("help", "show this help")
+        ("output", po::value<std::string>(&params.outputDir)->value_name("DIR")->default_value("."))
+        ("stops", po::value<size_t>(&params.stopCount)->value_name("N")->default_value(1000))
+        ("lines", po::value<size_t>(&params.lineCount)->value_name("N")->default_value(50))
+        ("route-length", po::value<size_t>(&params.routeLength)->value_name("N")->default_value(25))
+        ("peak-headway", po::value<unsigned>(&params.peakHeadway)->value_name("MINUTES")->default_value(10))
+        ("off-peak-headway", po::value<unsigned>(&params.offPeakHeadway)->value_name("MINUTES")->default_value(20))
+        ("weekend-headway", po::value<unsigned>(&params.weekendHeadway)->value_name("MINUTES")->default_value(30))
+        ("transfer-density", po::value<double>(&params.transferDensity)->value_name("P")->default_value(0.1),
+            "probability of a stop having a walking transfer")
+        ("spacing", po::value<double>(&params.spacing)->value_name("METRES")->default_value(250.0),
+            "distance between neighbour stops of the grid")
+        ("seed", po::value<unsigned long>(&params.seed)->value_name("N")->default_value(1))
+        ;
+    po::variables_map   vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+        if (params.stopCount < 2 || params.routeLength < 2) {
+            throw po::error("stops and route-length must be at least 2");
+        }
+        if (!params.peakHeadway || !params.offPeakHeadway || !params.weekendHeadway) {
+            throw po::error("headways must be positive");
+        }
+    } catch (const po::error& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "(Try \"netgen --help\")" << std::endl;
+        return 1;
+    }
+    if (vm.count("help")) {
+        std::cout << "Usage:" << std::endl;
+        std::cout << "  netgen [options]" << std::endl << std::endl;
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    try {
+        Generator{params}.run();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+    return 0;
+}
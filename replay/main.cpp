@@ -0,0 +1,214 @@
+//  replay: replays a query log against a network and reports latency percentiles.
+//
+//  Queries are issued by N client threads. With a target rate, query i is due at
+//  start + i / rate whatever happened before it (open loop), and its latency is measured from
+//  that due time, so a stall is charged to every query that had to wait for it (no coordinated
+//  omission). Service times, measured from the actual start, are reported alongside.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/value_semantic.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "../busplan/bus_network.hpp"
+#include "../busplan/config.hpp"
+#include "../busplan/day.hpp"
+#include "../busplan/details.hpp"
+#include "../busplan/lines.hpp"
+#include "../busplan/query_log.hpp"
+#include "../utility/histogram.hpp"
+#include "../utility/ini_doc.hpp"
+
+namespace {
+
+using ReplayClock = std::chrono::steady_clock;
+
+struct Results {
+    Results(): latency{}, service{}, errors{0} {
+    }
+
+    void merge(const Results& other) {
+        latency.merge(other.latency);
+        service.merge(other.service);
+        errors += other.errors;
+    }
+
+    Utility::Histogram  latency;
+    Utility::Histogram  service;
+    unsigned long       errors;
+};
+
+std::vector<Query> readLog(std::istream& is, Day defaultDay) {
+    std::vector<Query>  rv;
+    Query               query;
+    std::string         line;
+    while (true) {
+        try {
+            if (!readQuery(is, defaultDay, query, line)) {
+                break;
+            }
+            rv.push_back(query);
+        } catch (const std::invalid_argument& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    return rv;
+}
+
+void run(const BusNetwork& busNetwork, const Query& query, Details details) {
+    if (query.command == Command::getPlan) {
+        busNetwork.planFromArrive(query.day, query.from, query.to, query.arrive, details);
+    } else {
+        busNetwork.table(query.day, query.from, query.to, details);
+    }
+}
+
+void writeSummary(std::ostream& os, const char* name, const Utility::Histogram& h) {
+    os << std::left << std::setw(10) << name << std::right;
+    os << std::setw(10) << h.count() << std::setw(12) << static_cast<unsigned long>(h.mean());
+    os << std::setw(10) << h.percentile(50) << std::setw(10) << h.percentile(90);
+    os << std::setw(10) << h.percentile(99) << std::setw(10) << h.percentile(99.9);
+    os << std::setw(10) << h.max() << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    namespace po = boost::program_options;
+
+    std::string network, logFile;
+    size_t      clients, repeat;
+    double      rate;
+    Day         day;
+    Details     details;
+
+    po::options_description desc("Options");
+    desc.add_options()
+        ("help", "show this help")
+        ("network", po::value<std::string>(&network)->value_name("DIR")->default_value("."))
+        ("log", po::value<std::string>(&logFile)->value_name("FILE")->default_value("-"), "query log ('-' for stdin)")
+        ("clients", po::value<size_t>(&clients)->value_name("N")->default_value(1))
+        ("rate", po::value<double>(&rate)->value_name("QPS")->default_value(0.0), "target rate, 0 for closed loop")
+        ("repeat", po::value<size_t>(&repeat)->value_name("N")->default_value(1), "passes over the log")
+        ("date", po::value<Day>(&day)->value_name("DATE")->default_value(Day{"today"}), "day of queries without one")
+        ("details", po::value<Details>(&details)->value_name("DETAILS")->default_value(Details::steps))
+        ("histogram", "print the full latency distribution")
+        ;
+    po::variables_map   vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+        if (!clients) {
+            throw po::error("clients must be at least 1");
+        }
+    } catch (const po::error& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "(Try \"replay --help\")" << std::endl;
+        return 1;
+    }
+    if (vm.count("help")) {
+        std::cout << "Usage:" << std::endl;
+        std::cout << "  replay [options]" << std::endl << std::endl;
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    std::vector<Query>          queries;
+    std::unique_ptr<BusNetwork> busNetwork;
+    try {
+        if (logFile == "-") {
+            queries = readLog(std::cin, day);
+        } else {
+            std::ifstream   logf(logFile);
+            if (!logf.is_open()) {
+                throw std::runtime_error(std::string{"Unable to open \""}.append(logFile).append("\""));
+            }
+            queries = readLog(logf, day);
+        }
+
+        Utility::IniDoc     config;
+        Lines               lines;
+        StopDescriptions    stopdescs;
+        getConfig(config, network + "/busplan.cfg");
+        resolveImports(config, network);
+        read(config.doc(), lines, stopdescs);
+        busNetwork.reset(new BusNetwork{std::move(lines)});
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+    if (queries.empty()) {
+        std::cerr << "No queries to replay" << std::endl;
+        return 2;
+    }
+
+    auto                        total = queries.size() * repeat;
+    std::atomic<size_t>         next{0};
+    Results                     results;
+    std::mutex                  resultsMutex;
+    std::vector<std::thread>    threads;
+    auto                        start = ReplayClock::now();
+    auto                        interval = std::chrono::duration<double>(rate > 0.0 ? 1.0 / rate : 0.0);
+    for (size_t c = 0; c < clients; ++c) {
+        threads.emplace_back([&]() {
+            Results local;
+            for (auto i = next++; i < total; i = next++) {
+                const auto& query = queries[i % queries.size()];
+                auto        due = start + std::chrono::duration_cast<ReplayClock::duration>(interval * i);
+                if (rate > 0.0) {
+                    std::this_thread::sleep_until(due);
+                }
+                auto        begin = ReplayClock::now();
+                try {
+                    run(*busNetwork, query, details);
+                } catch (const std::exception&) {
+                    ++local.errors;
+                }
+                auto        end = ReplayClock::now();
+                auto        micros = [](ReplayClock::duration d) {
+                    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+                };
+                local.service.record(micros(end - begin));
+                local.latency.record(micros(end - (rate > 0.0 ? due : begin)));
+            }
+            std::lock_guard<std::mutex> lock{resultsMutex};
+            results.merge(local);
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    auto    elapsed = std::chrono::duration<double>(ReplayClock::now() - start).count();
+
+    std::cout << "queries: " << total << ", clients: " << clients << ", errors: " << results.errors << std::endl;
+    std::cout << "target rate: ";
+    if (rate > 0.0) {
+        std::cout << rate << " q/s";
+    } else {
+        std::cout << "closed loop";
+    }
+    std::cout << ", achieved: " << std::fixed << std::setprecision(1) << total / elapsed << " q/s" << std::endl;
+    std::cout << std::left << std::setw(10) << "(us)" << std::right << std::setw(10) << "count";
+    std::cout << std::setw(12) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p90";
+    std::cout << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "max" << std::endl;
+    writeSummary(std::cout, "latency", results.latency);
+    writeSummary(std::cout, "service", results.service);
+    if (vm.count("histogram")) {
+        std::cout << std::endl << "latency distribution (us, count, cumulative):" << std::endl;
+        std::cout << results.latency;
+    }
+    return 0;
+}
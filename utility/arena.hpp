@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __unix__
+#include <sys/mman.h>
+#endif
+
+namespace Utility {
+
+	//	Monotonic memory resource: allocations are carved out of a list of growing blocks and only
+	//	released, all at once, when the arena is destroyed. Freed chunks up to 64 KiB are kept for
+	//	allocations of the same size, so that growing vectors do not waste the space they leave
+	//	behind. Not thread safe.
+	//
+	//	On unix the blocks are mapped rather than taken from the heap, so that they go back to the
+	//	system with the arena. Freed to the heap, malloc would keep them, and the next load of the
+	//	model would fragment them.
+	class Arena {
+	public:
+		static const size_t	firstBlockSize = 64 * 1024;
+		static const size_t	maxBlockSize = 16 * 1024 * 1024;
+
+		Arena(): blocks_{}, freeChunks_(maxRecycledSize / chunkGranularity + 1, nullptr), current_{nullptr}, left_{0}, nextBlockSize_{firstBlockSize}, used_{0}, capacity_{0} {
+		}
+		//	First block on 'buffer', which must outlive the arena, rather than on the heap: a model
+		//	sized beforehand fits in a static buffer.
+		Arena(void* buffer, size_t size): Arena{} {
+			current_ = static_cast<char*>(buffer);
+			left_ = size;
+			capacity_ = size;
+		}
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+		~Arena() {
+			for (const auto& block: blocks_) {
+				releaseBlock(block.first, block.second);
+			}
+		}
+
+		void* allocate(size_t size, size_t alignment) {
+			if (isRecycled(size)) {
+				auto&	head = freeChunks_[size / chunkGranularity];
+				if (head && reinterpret_cast<std::uintptr_t>(head) % alignment == 0) {
+					auto	rv = head;
+					head = rv->next;
+					used_ += size;
+					return rv;
+				}
+			}
+			auto	padding = (alignment - reinterpret_cast<std::uintptr_t>(current_) % alignment) % alignment;
+			if (padding + size > left_) {
+				newBlock(size + alignment);
+				padding = (alignment - reinterpret_cast<std::uintptr_t>(current_) % alignment) % alignment;
+			}
+			auto	rv = current_ + padding;
+			current_ += padding + size;
+			left_ -= padding + size;
+			used_ += size;
+			return rv;
+		}
+		void deallocate(void* p, size_t size) {
+			used_ -= size;
+			if (isRecycled(size)) {
+				auto	chunk = static_cast<FreeChunk*>(p);
+				auto&	head = freeChunks_[size / chunkGranularity];
+				chunk->next = head;
+				head = chunk;
+			}
+		}
+
+		//	Bytes in use.
+		size_t used() const {
+			return used_;
+		}
+		//	Bytes reserved from the system.
+		size_t capacity() const {
+			return capacity_;
+		}
+		//	Bytes left in the current block.
+		size_t left() const {
+			return left_;
+		}
+		size_t blockCount() const {
+			return blocks_.size();
+		}
+
+	private:
+		struct FreeChunk {
+			FreeChunk*	next;
+		};
+		static const size_t	chunkGranularity = sizeof(FreeChunk);
+		static const size_t	maxRecycledSize = 64 * 1024;
+
+		static bool isRecycled(size_t size) {
+			return size != 0 && size % chunkGranularity == 0 && size <= maxRecycledSize;
+		}
+
+		static char* allocateBlock(size_t size) {
+#ifdef __unix__
+			auto	rv = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (rv == MAP_FAILED) {
+				throw std::bad_alloc{};
+			}
+			return static_cast<char*>(rv);
+#else
+			return new char[size];
+#endif
+		}
+		static void releaseBlock(char* block, size_t size) {
+#ifdef __unix__
+			::munmap(block, size);
+#else
+			(void)size;
+			delete[] block;
+#endif
+		}
+
+		void newBlock(size_t minSize) {
+			auto	size = std::max(nextBlockSize_, minSize);
+			blocks_.emplace_back(allocateBlock(size), size);
+			current_ = blocks_.back().first;
+			left_ = size;
+			capacity_ += size;
+			//	by value: the constant is not defined out of the class.
+			const size_t	maxSize = maxBlockSize;
+			nextBlockSize_ = std::min(nextBlockSize_ * 2, maxSize);
+		}
+
+		std::vector<std::pair<char*, size_t>>	blocks_;
+		std::vector<FreeChunk*>					freeChunks_;
+		char*									current_;
+		size_t									left_;
+		size_t									nextBlockSize_;
+		size_t									used_;
+		size_t									capacity_;
+	};
+
+	template <typename T>
+	class ArenaAllocator {
+	public:
+		using value_type = T;
+		using propagate_on_container_copy_assignment = std::false_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+
+		ArenaAllocator(): arena_{nullptr} {
+		}
+		explicit ArenaAllocator(Arena* arena): arena_{arena} {
+		}
+		template <typename U>
+		ArenaAllocator(const ArenaAllocator<U>& other): arena_{other.arena()} {
+		}
+
+		T* allocate(size_t n) {
+			if (arena_) {
+				return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+			}
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+		}
+		void deallocate(T* p, size_t n) {
+			if (arena_) {
+				arena_->deallocate(p, n * sizeof(T));
+			} else {
+				::operator delete(p);
+			}
+		}
+
+		ArenaAllocator select_on_container_copy_construction() const {
+			return ArenaAllocator{};
+		}
+
+		Arena* arena() const {
+			return arena_;
+		}
+
+	private:
+		Arena*	arena_;
+	};
+
+	template <typename T, typename U>
+	bool operator ==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+		return a.arena() == b.arena();
+	}
+	template <typename T, typename U>
+	bool operator !=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+		return !(a == b);
+	}
+
+	template <typename Key, typename T, typename Compare = std::less<Key>>
+	using ArenaMap = std::map<Key, T, Compare, ArenaAllocator<std::pair<const Key, T>>>;
+	template <typename T>
+	using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+	//	The value of 'key' in 'map', added if there is none, constructed with the arena of the
+	//	map so that its own containers allocate from it.
+	template <typename Map, typename Key>
+	typename Map::mapped_type& emplaceOnArena(Map& map, const Key& key) {
+		auto	it = map.find(key);
+		if (it == map.end()) {
+			it = map.emplace(
+				std::piecewise_construct, std::forward_as_tuple(key),
+				std::forward_as_tuple(map.get_allocator().arena())).first;
+		}
+		return it->second;
+	}
+	//	Add copies of the values of 'from' to 'to', each constructed from the value and the arena
+	//	of 'to'.
+	template <typename Map>
+	void copyOnArena(const Map& from, Map& to) {
+		for (const auto& value: from) {
+			to.emplace_hint(
+				to.end(), std::piecewise_construct, std::forward_as_tuple(value.first),
+				std::forward_as_tuple(value.second, to.get_allocator().arena()));
+		}
+	}
+
+}
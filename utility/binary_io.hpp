@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+namespace Utility {
+
+	//	Little endian fixed width integers, for the preprocessed data written next to a network.
+	template <typename T>
+	void writeLittleEndian(std::ostream& os, T value) {
+		char	bytes[sizeof(T)];
+		for (size_t i = 0; i < sizeof(T); ++i) {
+			bytes[i] = static_cast<char>((value >> (i * 8)) & 0xff);
+		}
+		os.write(bytes, sizeof(bytes));
+	}
+
+	//	Throws std::runtime_error at the end of the stream.
+	template <typename T>
+	T readLittleEndian(std::istream& is) {
+		unsigned char	bytes[sizeof(T)];
+		if (!is.read(reinterpret_cast<char*>(bytes), sizeof(bytes))) {
+			throw std::runtime_error("Unexpected end of data");
+		}
+		T	rv = 0;
+		for (size_t i = 0; i < sizeof(T); ++i) {
+			rv |= static_cast<T>(bytes[i]) << (i * 8);
+		}
+		return rv;
+	}
+
+	inline void write32(std::ostream& os, std::uint32_t value) {
+		writeLittleEndian(os, value);
+	}
+	inline void write64(std::ostream& os, std::uint64_t value) {
+		writeLittleEndian(os, value);
+	}
+	inline std::uint32_t read32(std::istream& is) {
+		return readLittleEndian<std::uint32_t>(is);
+	}
+	inline std::uint64_t read64(std::istream& is) {
+		return readLittleEndian<std::uint64_t>(is);
+	}
+
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+namespace Utility {
+
+	//	Log-linear histogram of non negative integer values: every power of two is split in
+	//	'subBucketCount' linear buckets, so recorded values keep a relative precision of
+	//	1/subBucketCount whatever their magnitude. Recording is O(1) and never allocates.
+	class Histogram {
+	public:
+		using value_type = std::uint64_t;
+
+		static const unsigned subBucketBits = 5;
+		static const unsigned subBucketCount = 1u << subBucketBits;
+
+		Histogram():
+			buckets_((64 - subBucketBits + 1) * subBucketCount, 0), count_{0}, sum_{0},
+			min_{std::numeric_limits<value_type>::max()}, max_{0} {
+		}
+
+		void record(value_type value, value_type times = 1) {
+			buckets_[bucketIndex(value)] += times;
+			count_ += times;
+			sum_ += value * times;
+			min_ = std::min(min_, value);
+			max_ = std::max(max_, value);
+		}
+		void merge(const Histogram& other) {
+			for (size_t i = 0; i < buckets_.size(); ++i) {
+				buckets_[i] += other.buckets_[i];
+			}
+			count_ += other.count_;
+			sum_ += other.sum_;
+			min_ = std::min(min_, other.min_);
+			max_ = std::max(max_, other.max_);
+		}
+		void clear() {
+			std::fill(buckets_.begin(), buckets_.end(), 0);
+			count_ = sum_ = max_ = 0;
+			min_ = std::numeric_limits<value_type>::max();
+		}
+
+		value_type count() const {
+			return count_;
+		}
+		value_type min() const {
+			return count_ ? min_ : 0;
+		}
+		value_type max() const {
+			return max_;
+		}
+		double mean() const {
+			return count_ ? static_cast<double>(sum_) / count_ : 0.0;
+		}
+		//	Highest value equivalent to the p-th percentile (0 <= p <= 100).
+		value_type percentile(double p) const {
+			if (!count_) {
+				return 0;
+			}
+			auto		rank = static_cast<value_type>(p / 100.0 * count_ + 0.5);
+			value_type	seen = 0;
+			rank = std::max<value_type>(1, std::min(rank, count_));
+			for (size_t i = 0; i < buckets_.size(); ++i) {
+				seen += buckets_[i];
+				if (seen >= rank) {
+					return std::min(bucketTop(i), max_);
+				}
+			}
+			return max_;
+		}
+
+		//	One line per non empty bucket: "<upper bound> <count> <cumulative fraction>".
+		std::ostream& write(std::ostream& os) const {
+			value_type	seen = 0;
+			for (size_t i = 0; i < buckets_.size(); ++i) {
+				if (buckets_[i]) {
+					seen += buckets_[i];
+					os << bucketTop(i) << "\t" << buckets_[i] << "\t" << static_cast<double>(seen) / count_ << std::endl;
+				}
+			}
+			return os;
+		}
+
+	private:
+		static size_t bucketIndex(value_type value) {
+			if (value < subBucketCount) {
+				return static_cast<size_t>(value);
+			}
+			unsigned	magnitude = 63 - leadingZeros(value);
+			unsigned	shift = magnitude - subBucketBits;
+			return (shift + 1) * subBucketCount + static_cast<size_t>((value >> shift) - subBucketCount);
+		}
+		static value_type bucketTop(size_t index) {
+			if (index < subBucketCount) {
+				return index;
+			}
+			unsigned	shift = static_cast<unsigned>(index / subBucketCount) - 1;
+			value_type	base = (index % subBucketCount) + subBucketCount;
+			return ((base + 1) << shift) - 1;
+		}
+		static unsigned leadingZeros(value_type value) {
+#ifdef __GNUC__
+			return static_cast<unsigned>(__builtin_clzll(value));
+#else
+			unsigned	rv = 0;
+			for (value_type bit = value_type{1} << 63; !(value & bit); bit >>= 1) {
+				++rv;
+			}
+			return rv;
+#endif
+		}
+
+		std::vector<value_type>	buckets_;
+		value_type				count_;
+		value_type				sum_;
+		value_type				min_;
+		value_type				max_;
+	};
+
+	inline std::ostream& operator<<(std::ostream& os, const Histogram& histogram) {
+		return histogram.write(os);
+	}
+
+} // Utility
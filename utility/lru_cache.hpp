@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Utility {
+
+	//	Least recently used cache shared by concurrent threads. Keys are spread over shards by
+	//	their hash, each one with its own lock, list and capacity, so threads asking for
+	//	different keys seldom wait for each other. Entries carry the generation of the data
+	//	they were computed from, and are dropped when asked for with another generation or once
+	//	older than the time to live.
+	template <typename Key, typename Value, typename Hash = std::hash<Key>>
+	class LruCache {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		static const size_t	defaultShardCount = 16;
+
+		LruCache(size_t capacity, Clock::duration ttl, size_t shardCount = defaultShardCount):
+			shards_(std::max<size_t>(1, std::min(shardCount, capacity))), hash_{}, ttl_{ttl},
+			shardCapacity_{(capacity + shards_.size() - 1) / shards_.size()}, hits_{0}, misses_{0} {
+		}
+		LruCache(const LruCache&) = delete;
+		LruCache& operator=(const LruCache&) = delete;
+
+		//	Copy the value of 'key' computed for 'generation' into 'value', making it the most
+		//	recently used. Returns false if there is none.
+		bool find(const Key& key, unsigned long generation, Value& value) {
+			auto&	shard = shardOf(key);
+			{
+				std::lock_guard<std::mutex>	lock{shard.mutex};
+				auto	it = shard.index.find(key);
+				if (it != shard.index.end()) {
+					auto	entry = it->second;
+					if (entry->generation == generation && Clock::now() - entry->stored < ttl_) {
+						shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+						value = entry->value;
+						hits_.fetch_add(1, std::memory_order_relaxed);
+						return true;
+					}
+					shard.index.erase(it);
+					shard.entries.erase(entry);
+				}
+			}
+			misses_.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		//	Store 'value' for 'key', dropping the least recently used entry of its shard when
+		//	full.
+		void insert(const Key& key, unsigned long generation, Value value) {
+			if (shardCapacity_ == 0) {
+				return;
+			}
+			auto&						shard = shardOf(key);
+			std::lock_guard<std::mutex>	lock{shard.mutex};
+			auto	it = shard.index.find(key);
+			if (it != shard.index.end()) {
+				shard.entries.erase(it->second);
+				shard.index.erase(it);
+			} else if (shard.index.size() >= shardCapacity_) {
+				shard.index.erase(shard.entries.back().key);
+				shard.entries.pop_back();
+			}
+			shard.entries.push_front(Entry{key, std::move(value), generation, Clock::now()});
+			shard.index.emplace(key, shard.entries.begin());
+		}
+		void clear() {
+			for (auto& shard: shards_) {
+				std::lock_guard<std::mutex>	lock{shard.mutex};
+				shard.index.clear();
+				shard.entries.clear();
+			}
+		}
+
+		size_t size() const {
+			size_t	rv = 0;
+			for (auto& shard: shards_) {
+				std::lock_guard<std::mutex>	lock{shard.mutex};
+				rv += shard.index.size();
+			}
+			return rv;
+		}
+		unsigned long hits() const {
+			return hits_.load(std::memory_order_relaxed);
+		}
+		unsigned long misses() const {
+			return misses_.load(std::memory_order_relaxed);
+		}
+
+	private:
+		struct Entry {
+			Key					key;
+			Value				value;
+			unsigned long		generation;
+			Clock::time_point	stored;
+		};
+		using Entries = std::list<Entry>;
+		struct Shard {
+			mutable std::mutex											mutex;
+			Entries														entries;	//	most recently used first
+			std::unordered_map<Key, typename Entries::iterator, Hash>	index;
+		};
+
+		Shard& shardOf(const Key& key) {
+			return shards_[hash_(key) % shards_.size()];
+		}
+
+		std::vector<Shard>			shards_;
+		Hash						hash_;
+		Clock::duration				ttl_;
+		size_t						shardCapacity_;
+		std::atomic<unsigned long>	hits_;
+		std::atomic<unsigned long>	misses_;
+	};
+
+}